@@ -19,10 +19,12 @@
 #include "optimizer/cost.h"
 #include "optimizer/var.h"
 #include "parser/parsetree.h"
+#include "access/htup_details.h"
 #include "storage/ipc.h"
 #include "utils/builtins.h"
 #include "utils/guc.h"
 #include "utils/lsyscache.h"
+#include "utils/syscache.h"
 #include "pg_strom.h"
 #include "opencl_gpusort.h"
 #include <math.h>
@@ -36,6 +38,9 @@ typedef struct
 	List	   *used_params;	/* list of Const/Param being referenced */
 	Bitmapset  *sortkey_resnums;/* resource numbers of sortkey */
 	Size		sortkey_width;	/* width of sortkey */
+	cl_int		radix_attlen;	/* attlen of sort key, if radix sorting is
+								 * applicable. elsewhere 0 */
+	bool		radix_reverse;	/* true, if descending ordered */
 
 	/* delivered from original Sort */
 	int			numCols;		/* number of sort-key columns */
@@ -56,6 +61,8 @@ typedef struct
 	List		   *sortkey_resnums;/* list of resno of sortkeys */
 	List		   *sortkey_toast;	/* list of resno of variable sortkeys */
 	Size			sortkey_width;
+	cl_int			radix_attlen;	/* see GpuSortPlan */
+	bool			radix_reverse;
 	Size			gpusort_chunksz;
 	cl_uint			nrows_per_chunk;
 	bool			bulk_scan;
@@ -78,6 +85,7 @@ typedef struct
 
 /* static variables */
 static int						pgstrom_gpusort_chunksize;
+static bool						pgstrom_gpusort_persistent;
 static CustomPlanMethods		gpusort_plan_methods;
 
 /* static declarations */
@@ -102,7 +110,7 @@ compute_gpusort_chunksize(Size width, double nrows,
 	Size		device_restriction;
 	Size		chunk_sz;
 	Size		base_len;
-	int			nkeys = list_length(sortkey_resnums) + 2;
+	int			nkeys = list_length(sortkey_resnums) + 3;
 
 	/*
 	 * zone length is initialized to device's max memory allocation size
@@ -117,12 +125,12 @@ compute_gpusort_chunksize(Size width, double nrows,
 	base_len = (offsetof(pgstrom_gpusort_chunk, kern) +
 				STROMALIGN(kparams->length) +
 				STROMALIGN(offsetof(kern_column_store, colmeta[nkeys])) +
-				STROMALIGN(sizeof(cl_int)) +
+				STROMALIGN(3 * sizeof(cl_ulong)) +	/* status + key range */
 				STROMALIGN(offsetof(kern_toastbuf, coldir[0])));
 	/*
 	 * Try to estimate the chunk size being required in this context.
 	 */
-	width += 2 * sizeof(cl_uint) + sizeof(cl_ulong);
+	width += 2 * sizeof(cl_uint) + 2 * sizeof(cl_ulong);
 
 	/* if too large, nrows per chunk has to be reduced */
 	while ((chunk_sz = (Size)
@@ -224,6 +232,68 @@ expected_key_width(TargetEntry *tle, Plan *subplan, List *rtable)
 	return sizeof(cl_uint) + MAXALIGN(type_len);
 }
 
+/*
+ * sortkey_is_attnotnull
+ *
+ * It checks whether the supplied sort key has not-null constraint on
+ * the underlying relation; a precondition of radix sorting that does
+ * not deal with null values. Note that TupleDesc of the subplan does
+ * not preserve the constraint, so we look at the system catalog as
+ * long as the underlying plan is a usual relation scan.
+ */
+static bool
+sortkey_is_attnotnull(TargetEntry *tle, Plan *subplan, List *rtable)
+{
+	if (IsA(tle->expr, Var) && (IsA(subplan, SeqScan) ||
+								IsA(subplan, IndexScan) ||
+								IsA(subplan, IndexOnlyScan) ||
+								IsA(subplan, BitmapHeapScan) ||
+								IsA(subplan, TidScan) ||
+								IsA(subplan, ForeignScan)))
+	{
+		Var	   *var = (Var *)tle->expr;
+		Index	scanrelid = ((Scan *)subplan)->scanrelid;
+		RangeTblEntry *rte = rt_fetch(scanrelid, rtable);
+		TargetEntry *sub_tle;
+		Var		   *sub_var;
+		HeapTuple	tuple;
+		bool		result = false;
+
+		Assert(var->varno == OUTER_VAR);
+		Assert(rte->rtekind == RTE_RELATION && OidIsValid(rte->relid));
+
+		/*
+		 * The sort key is an OUTER_VAR reference, so its varattno is
+		 * a resno on the targetlist of the subplan, not an attribute
+		 * number of the underlying relation; they match only as long
+		 * as the scan returns physical tuples. Resolve it down to the
+		 * Var on the relation being scanned, prior to the syscache
+		 * lookup; elsewhere we may pick an attribute unrelated to the
+		 * sort key, and a false not-null assumption leads to incorrect
+		 * sorting results, not just costing mistakes.
+		 */
+		sub_tle = get_tle_by_resno(subplan->targetlist, var->varattno);
+		if (!sub_tle || !IsA(sub_tle->expr, Var))
+			return false;
+		sub_var = (Var *) sub_tle->expr;
+		if (sub_var->varno != scanrelid ||
+			sub_var->varattno <= 0 ||
+			sub_var->varlevelsup != 0)
+			return false;
+
+		tuple = SearchSysCache2(ATTNUM,
+								ObjectIdGetDatum(rte->relid),
+								Int16GetDatum(sub_var->varattno));
+		if (HeapTupleIsValid(tuple))
+		{
+			result = ((Form_pg_attribute) GETSTRUCT(tuple))->attnotnull;
+			ReleaseSysCache(tuple);
+		}
+		return result;
+	}
+	return false;
+}
+
 
 
 
@@ -272,16 +342,24 @@ cost_gpusort(Cost *p_startup_cost, Cost *p_total_cost,
 }
 
 static char *
-gpusort_codegen_comparison(Sort *sort, codegen_context *context)
+gpusort_codegen_comparison(Sort *sort, Plan *subplan, List *rtable,
+						   codegen_context *context)
 {
 	StringInfoData	str;
 	StringInfoData	decl;
 	StringInfoData	body;
+	StringInfoData	enc;
+	const char	   *fastpath = "";
+	const char	   *enc_typename = NULL;
+	Oid				enc_typeoid = InvalidOid;
+	AttrNumber		enc_colidx = 0;
+	bool			enc_reverse = false;
 	int				i, j;
 
 	initStringInfo(&str);
 	initStringInfo(&decl);
 	initStringInfo(&body);
+	initStringInfo(&enc);
 
 	memset(context, 0, sizeof(codegen_context));
 
@@ -320,6 +398,7 @@ gpusort_codegen_comparison(Sort *sort, codegen_context *context)
 		bool		is_reverse;
 		AttrNumber	var_index;
 		Var		   *tvar;
+		bool		notnull;
 		devtype_info *dtype;
 		devfunc_info *dfunc;
 
@@ -336,6 +415,14 @@ gpusort_codegen_comparison(Sort *sort, codegen_context *context)
 		sort_func = get_compare_function(sort_op, &is_reverse);
 		dfunc = pgstrom_devfunc_lookup_and_track(sort_func, context);
 
+		/*
+		 * If the underlying column has not-null constraint, we can
+		 * specialize the comparator; null handling branches are
+		 * dead code, so the generated comparison becomes a straight
+		 * line towards pgfn_ invocation.
+		 */
+		notnull = sortkey_is_attnotnull(tle, subplan, rtable);
+
 		appendStringInfo(&decl,
 						 "  pg_%s_t keyval_x%u;\n"
 						 "  pg_%s_t keyval_y%u;\n",
@@ -353,6 +440,23 @@ gpusort_codegen_comparison(Sort *sort, codegen_context *context)
 				var_index++;
 		}
 
+		/*
+		 * If the first sort key is a not-null fixed-width integer, its
+		 * order-preserving 64bit encoding gets materialized on the setup
+		 * stage, so the comparison below can decide the ordering of the
+		 * first key with a single coalesced load on the encoded array.
+		 */
+		if (i == 0 && notnull &&
+			(sort_type == INT2OID ||
+			 sort_type == INT4OID ||
+			 sort_type == INT8OID))
+		{
+			enc_typeoid = sort_type;
+			enc_typename = dtype->type_name;
+			enc_colidx = var_index;
+			enc_reverse = is_reverse;
+		}
+
 		/* reference to kcs-x */
 		appendStringInfo(&body, "  keyval_x%u = ", i+1);
 		if (dtype->type_flags & DEVTYPE_IS_VARLENA)
@@ -379,30 +483,114 @@ gpusort_codegen_comparison(Sort *sort, codegen_context *context)
 				"pg_%s_vref(kcs_y,errcode,%u,y_index);\n",
 				dtype->type_name, var_index);
 
+		if (notnull)
+			appendStringInfo(
+				&body,
+				"  comp = pgfn_%s(errcode, keyval_x%u, keyval_y%u);\n"
+				"  if (comp.value != 0)\n"
+				"    return %s;\n",
+				dfunc->func_name, i+1, i+1,
+				is_reverse ? "-comp.value" : "comp.value");
+		else
+			appendStringInfo(
+				&body,
+				"  if (!keyval_x%u.isnull && !keyval_y%u.isnull)\n"
+				"  {\n"
+				"    comp = pgfn_%s(errcode, keyval_x%u, keyval_y%u);\n"
+				"    if (comp.value != 0)\n"
+				"      return %s;\n"
+				"  }\n"
+				"  else if (keyval_x%u.isnull && !keyval_y%u.isnull)\n"
+				"    return %d;\n"
+				"  else if (!keyval_x%u.isnull && keyval_y%u.isnull)\n"
+				"    return %d;\n",
+				i+1, i+1,
+				dfunc->func_name, i+1, i+1,
+				is_reverse ? "-comp.value" : "comp.value",
+				i+1, i+1, nullfirst ? -1 :  1,
+				i+1, i+1, nullfirst ?  1 : -1);
+	}
+
+	/*
+	 * generate the sort-key encoder; see the description around the
+	 * declaration of gpusort_keyenc() in opencl_gpusort.h.
+	 */
+	if (OidIsValid(enc_typeoid))
+	{
+		const char *enc_expr;
+		const char *enc_mask;
+
+		if (enc_typeoid == INT2OID)
+		{
+			enc_expr = "(cl_ulong)(cl_ushort)(keyval.value ^ 0x8000)";
+			enc_mask = "(cl_ulong)0xffff";
+		}
+		else if (enc_typeoid == INT4OID)
+		{
+			enc_expr = "(cl_ulong)(cl_uint)(keyval.value ^ 0x80000000)";
+			enc_mask = "(cl_ulong)0xffffffff";
+		}
+		else
+		{
+			enc_expr = "(cl_ulong)keyval.value ^ ((cl_ulong)1 << 63)";
+			enc_mask = "~(cl_ulong)0";
+		}
+		appendStringInfo(
+			&enc,
+			"static cl_ulong\n"
+			"gpusort_keyenc(__private cl_int *errcode,\n"
+			"               __global kern_column_store *kcs,\n"
+			"               __global kern_toastbuf *ktoast,\n"
+			"               cl_int index)\n"
+			"{\n"
+			"  pg_%s_t keyval = pg_%s_vref(kcs,errcode,%u,index);\n"
+			"  cl_ulong encoded = %s;\n",
+			enc_typename, enc_typename, enc_colidx, enc_expr);
+		if (enc_reverse)
+			appendStringInfo(
+				&enc,
+				"  encoded = ~encoded & %s;\n", enc_mask);
+		appendStringInfo(
+			&enc,
+			"  return encoded;\n"
+			"}\n");
+
+		appendStringInfo(&decl,
+						 "  cl_ulong keyenc_x;\n"
+						 "  cl_ulong keyenc_y;\n");
+		fastpath =
+			"  /* fast path on the encoded keys; ordering by the first\n"
+			"   * sort key is decided with one coalesced load per side,\n"
+			"   * only the rows that tie fall towards the generic part */\n"
+			"  keyenc_x = gpusort_keys(kcs_x)[x_index];\n"
+			"  keyenc_y = gpusort_keys(kcs_y)[y_index];\n"
+			"  if (keyenc_x != keyenc_y)\n"
+			"    return keyenc_x < keyenc_y ? -1 : 1;\n"
+			"\n";
+	}
+	else
 		appendStringInfo(
-			&body,
-			"  if (!keyval_x%u.isnull && !keyval_y%u.isnull)\n"
-			"  {\n"
-			"    comp = pgfn_%s(errcode, keyval_x%u, keyval_y%u);\n"
-			"    if (comp.value != 0)\n"
-			"      return %s;\n"
-			"  }\n"
-			"  else if (keyval_x%u.isnull && !keyval_y%u.isnull)\n"
-			"    return %d;\n"
-			"  else if (!keyval_x%u.isnull && keyval_y%u.isnull)\n"
-			"    return %d;\n",
-			i+1, i+1,
-			dfunc->func_name, i+1, i+1,
-			is_reverse ? "-comp.value" : "comp.value",
-			i+1, i+1, nullfirst ? -1 :  1,
-			i+1, i+1, nullfirst ?  1 : -1);
-	}
-
-	/* make a comparison function */
+			&enc,
+			"static cl_ulong\n"
+			"gpusort_keyenc(__private cl_int *errcode,\n"
+			"               __global kern_column_store *kcs,\n"
+			"               __global kern_toastbuf *ktoast,\n"
+			"               cl_int index)\n"
+			"{\n"
+			"  return 0;\n"
+			"}\n");
+
+	/*
+	 * make a comparison function; it is invoked from the innermost loop
+	 * of every sorting kernel, so we force the compiler to inline it.
+	 * Being left as a real call, each call site has to keep the whole
+	 * set of argument registers alive, that inflates register usage and
+	 * reduces number of threads able to run simultaneously.
+	 */
 	appendStringInfo(
 		&str,
 		"%s\n"	/* type function declarations */
-		"static cl_int\n"
+		"static inline __attribute__((always_inline)) cl_int\n"
 		"gpusort_comp(__private int *errcode,\n"
 		"             __global kern_column_store *kcs_x,\n"
 		"             __global kern_toastbuf *ktoast_x,\n"
@@ -414,15 +602,47 @@ gpusort_codegen_comparison(Sort *sort, codegen_context *context)
 		"%s"	/* key variable declarations */
 		"  pg_int4_t comp;\n"
 		"\n"
+		"%s"	/* fast path on the encoded keys, if any */
 		"%s"	/* comparison body */
 		"  return 0;\n"
-		"}\n",
+		"}\n"
+		"\n"
+		/*
+		 * accessors of the reserved columns; KGS_KEYS_OFS, KGS_GROWID_OFS
+		 * and KGS_RESULT_OFS are put on the head of kernel source at
+		 * gpusort_begin, once layout of the sorting chunk gets fixed.
+		 */
+		"static __global cl_int *\n"
+		"gpusort_result_index(__global kern_column_store *kchunk)\n"
+		"{\n"
+		"  return (__global cl_int *)((__global char *)kchunk +\n"
+		"                             KGS_RESULT_OFS);\n"
+		"}\n"
+		"\n"
+		"static __global cl_ulong *\n"
+		"gpusort_global_rowid(__global kern_column_store *kchunk)\n"
+		"{\n"
+		"  return (__global cl_ulong *)((__global char *)kchunk +\n"
+		"                               KGS_GROWID_OFS);\n"
+		"}\n"
+		"\n"
+		"static __global cl_ulong *\n"
+		"gpusort_keys(__global kern_column_store *kchunk)\n"
+		"{\n"
+		"  return (__global cl_ulong *)((__global char *)kchunk +\n"
+		"                               KGS_KEYS_OFS);\n"
+		"}\n"
+		"\n"
+		"%s",	/* the sort-key encoder */
 		pgstrom_codegen_declarations(context),
 		decl.data,
-		body.data);
+		fastpath,
+		body.data,
+		enc.data);
 
 	pfree(decl.data);
 	pfree(body.data);
+	pfree(enc.data);
 
 	return str.data;
 }
@@ -442,6 +662,8 @@ pgstrom_create_gpusort_plan(Sort *sort, List *rtable)
 	Bitmapset  *sortkey_resnums = NULL;
 	Cost		startup_cost;
 	Cost		total_cost;
+	cl_int		radix_attlen = 0;
+	bool		radix_reverse = false;
 	codegen_context context;
 	int			i, n;
 
@@ -478,6 +700,30 @@ pgstrom_create_gpusort_plan(Sort *sort, List *rtable)
 					   &sortkey_resnums);
 	}
 
+	/*
+	 * If the sort key is a single not-null fixed-width integer column,
+	 * in-chunk sorting can take LSD radix sort instead of the bitonic
+	 * one; O(N * attlen) global passes, rather than O(N log^2 N)
+	 * comparator invocations.
+	 */
+	if (n == 1)
+	{
+		TargetEntry	*tle = get_tle_by_resno(tlist, sort->sortColIdx[0]);
+		Oid		type_oid = exprType((Node *)tle->expr);
+		bool	is_reverse;
+
+		if ((type_oid == INT2OID ||
+			 type_oid == INT4OID ||
+			 type_oid == INT8OID) &&
+			sortkey_is_attnotnull(tle, subplan, rtable) &&
+			OidIsValid(get_compare_function(sort->sortOperators[0],
+											&is_reverse)))
+		{
+			radix_attlen = get_typlen(type_oid);
+			radix_reverse = is_reverse;
+		}
+	}
+
 	/* next, cost estimation by GPU sort */
 	cost_gpusort(&startup_cost, &total_cost,
 				 subplan->total_cost,
@@ -497,11 +743,14 @@ pgstrom_create_gpusort_plan(Sort *sort, List *rtable)
 	gsort->cplan.plan.total_cost = total_cost;
 	gsort->cplan.methods = &gpusort_plan_methods;
 
-	gsort->kern_source = gpusort_codegen_comparison(sort, &context);
+	gsort->kern_source = gpusort_codegen_comparison(sort, subplan, rtable,
+													&context);
 	gsort->extra_flags = context.extra_flags | DEVKERNEL_NEEDS_GPUSORT;
 	gsort->used_params = context.used_params;
 	gsort->sortkey_resnums = sortkey_resnums;
 	gsort->sortkey_width = sortkey_width;
+	gsort->radix_attlen = radix_attlen;
+	gsort->radix_reverse = radix_reverse;
 
 	gsort->numCols = sort->numCols;
 	gsort->sortColIdx = pmemcpy(sort->sortColIdx, sizeof(AttrNumber) * n);
@@ -568,8 +817,8 @@ gpusort_finalize_plan(PlannerInfo *root,
 /*
  * gpusort_construct_kcshead
  *
- * It sets up header portion of kern_column_store that can contain two
- * system columns on gpusort (growid and rindex).
+ * It sets up header portion of kern_column_store that can contain three
+ * system columns on gpusort (encoded keys, growid and rindex).
  */
 static bytea *
 gpusort_construct_kcshead(TupleDesc tupdesc, cl_char *attrefs)
@@ -578,10 +827,25 @@ gpusort_construct_kcshead(TupleDesc tupdesc, cl_char *attrefs)
 	bytea	   *result;
 	AttrNumber	i_col;
 
-	/* make a kcs_head with 2 additional columns */
-	result = kparam_make_kcs_head(tupdesc, attrefs, 2, 100);
+	/* make a kcs_head with 3 additional columns */
+	result = kparam_make_kcs_head(tupdesc, attrefs, 3, 100);
 	kcs_head = (kern_column_store *) VARDATA(result);
 
+	/*
+	 * The third last column is reserved by GpuSort - fixed-length
+	 * unsigned long integer; gpusort_keyenc() encodes the first sort
+	 * key of each tuple into an order-preserving 64bit value here on
+	 * the setup stage, so both of the comparator fast path and the
+	 * radix passes can fetch it with one coalesced load, not null.
+	 */
+	i_col = kcs_head->ncols - 3;
+	kcs_head->colmeta[i_col].attnotnull = true;
+	kcs_head->colmeta[i_col].attalign = sizeof(cl_long);
+	kcs_head->colmeta[i_col].attlen = sizeof(cl_long);
+	kcs_head->colmeta[i_col].cs_ofs = kcs_head->length;
+	kcs_head->length += STROMALIGN(sizeof(cl_long) * kcs_head->nrooms);
+	i_col++;
+
 	/*
 	 * The second last column is reserved by GpuSort - fixed-length
 	 * long integer as identifier of unsorted tuples, not null.
@@ -635,6 +899,7 @@ pgstrom_create_gpusort_chunk(GpuSortState *gsortstate)
 	kern_column_store *kcs;
 	kern_column_store *kcs_head;
 	cl_int		   *kstatus;
+	cl_ulong	   *keyrange;
 	kern_toastbuf  *ktoast;
 
 	/* allocation of a shared memory block */
@@ -661,6 +926,15 @@ pgstrom_create_gpusort_chunk(GpuSortState *gsortstate)
 	kstatus = KERN_GPUSORT_STATUS(&gs_chunk->kern);
 	*kstatus = StromError_Success;
 
+	/*
+	 * The key range next to the status word begins from the empty range
+	 * (min > max); it also means "unknown", if the device lacks 64bit
+	 * atomics and gpusort_keyrange_update never narrows it.
+	 */
+	keyrange = KERN_GPUSORT_KEYRANGE(&gs_chunk->kern);
+	keyrange[0] = (cl_ulong)(-1);
+	keyrange[1] = 0;
+
 	/* last, initialization of toast buffer in flat-mode */
 	ktoast = KERN_GPUSORT_TOASTBUF(&gs_chunk->kern);
 	if (gsortstate->sortkey_toast == NIL)
@@ -916,6 +1190,9 @@ pgstrom_create_gpusort(GpuSortState *gsortstate)
 	gpusort->dprog_key = pgstrom_retain_devprog_key(gsortstate->dprog_key);
 	gpusort->has_rindex = gsortstate->bulk_scan;
 	gpusort->is_sorted = false;
+	gpusort->radix_attlen = gsortstate->radix_attlen;
+	gpusort->radix_reverse = gsortstate->radix_reverse;
+	gpusort->sort_persistent = pgstrom_gpusort_persistent;
 	dlist_init(&gpusort->gs_chunks);
 
 	return gpusort;
@@ -1409,6 +1686,8 @@ gpusort_begin(CustomPlan *node, EState *estate, int eflags)
 	Const		   *kparam_1;
 	bytea		   *pdatum;
 	List		   *used_params;
+	kern_column_store *kcs_head;
+	StringInfoData	kern_source;
 
 	/*
 	 * create state structure
@@ -1461,12 +1740,7 @@ gpusort_begin(CustomPlan *node, EState *estate, int eflags)
 	 * Let's start to setting up GpuSort stuff.
 	 */
 
-	/* Setting up device kernel */
-	gsortstate->dprog_key = pgstrom_get_devprog_key(gsortplan->kern_source,
-													gsortplan->extra_flags);
-	pgstrom_track_object((StromObject *)gsortstate->dprog_key, 0);
-
-	/* Also, message queue */
+	/* Message queue of the backend */
 	gsortstate->mqueue = pgstrom_create_queue();
 	pgstrom_track_object(&gsortstate->mqueue->sobj, 0);
 
@@ -1521,12 +1795,39 @@ gpusort_begin(CustomPlan *node, EState *estate, int eflags)
 							  &gpusort_chunksz,
 							  &nrows_per_chunk);
 
+	/*
+	 * Setting up device kernel. All the sorting chunks of this node share
+	 * the same nrows_per_chunk, so layout of the sorting chunk is already
+	 * fixed here; offsets of the reserved columns are put on the head
+	 * of the kernel source as preprocessor constants, to be referenced by
+	 * the generated accessor functions instead of colmeta[] loads from
+	 * global memory on each reference.
+	 */
+	kparam_refresh_kcs_head(gsortstate->kparambuf, 0, nrows_per_chunk);
+	kcs_head = KPARAM_GET_KCS_HEAD(gsortstate->kparambuf);
+	initStringInfo(&kern_source);
+	appendStringInfo(&kern_source,
+					 "#define KGS_KEYS_OFS %u\n"
+					 "#define KGS_GROWID_OFS %u\n"
+					 "#define KGS_RESULT_OFS %u\n"
+					 "%s",
+					 kcs_head->colmeta[kcs_head->ncols - 3].cs_ofs,
+					 kcs_head->colmeta[kcs_head->ncols - 2].cs_ofs,
+					 kcs_head->colmeta[kcs_head->ncols - 1].cs_ofs,
+					 gsortplan->kern_source);
+	gsortstate->dprog_key = pgstrom_get_devprog_key(kern_source.data,
+													gsortplan->extra_flags);
+	pgstrom_track_object((StromObject *)gsortstate->dprog_key, 0);
+	pfree(kern_source.data);
+
 	/*
 	 * misc initialization of GpuSortState
 	 */
 	gsortstate->sortkey_resnums = sortkey_resnums;
 	gsortstate->sortkey_toast = sortkey_toast;
 	gsortstate->sortkey_width = gsortplan->sortkey_width;
+	gsortstate->radix_attlen = gsortplan->radix_attlen;
+	gsortstate->radix_reverse = gsortplan->radix_reverse;
 	gsortstate->gpusort_chunksz = gpusort_chunksz;
 	gsortstate->nrows_per_chunk = nrows_per_chunk;
 
@@ -1944,6 +2245,11 @@ gpusort_textout_plan(StringInfo str, const CustomPlan *node)
 	appendStringInfo(str, " :sortkey_width %zu",
 					 plannode->sortkey_width);
 
+	appendStringInfo(str, " :radix_attlen %d", plannode->radix_attlen);
+
+	appendStringInfo(str, " :radix_reverse %s",
+					 plannode->radix_reverse ? "true" : "false");
+
 	appendStringInfo(str, " :numCols %d", plannode->numCols);
 
 	appendStringInfoString(str, " :sortColIdx");
@@ -1977,6 +2283,8 @@ gpusort_copy_plan(const CustomPlan *from)
 	newnode->used_params = copyObject(oldnode->used_params);
 	newnode->sortkey_resnums = bms_copy(oldnode->sortkey_resnums);
 	newnode->sortkey_width = oldnode->sortkey_width;
+	newnode->radix_attlen = oldnode->radix_attlen;
+	newnode->radix_reverse = oldnode->radix_reverse;
 
 	newnode->numCols     = oldnode->numCols;
 	newnode->sortColIdx = pmemcpy(oldnode->sortColIdx, sizeof(AttrNumber) * n);
@@ -2005,6 +2313,22 @@ pgstrom_init_gpusort(void)
 							GUC_NOT_IN_SAMPLE,
 							NULL, NULL, NULL);
 
+	/*
+	 * on/off of the persistent in-chunk sorting kernel; it runs whole
+	 * of the bitonic network on a single kernel invocation, instead of
+	 * one launch per sub-stage. Disabled by default because it relies
+	 * on all the workgroups being resident simultaneously, that is not
+	 * a guarantee of the OpenCL specification.
+	 */
+	DefineCustomBoolVariable("pg_strom.gpusort_persistent",
+							 "run in-chunk sorting on a single persistent kernel",
+							 NULL,
+							 &pgstrom_gpusort_persistent,
+							 false,
+							 PGC_SUSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
 	/* initialization of plan method table */
 	gpusort_plan_methods.CustomName = "GpuSort";
 	gpusort_plan_methods.SetCustomPlanRef = gpusort_set_plan_ref;
@@ -2033,6 +2357,10 @@ typedef struct
 	pgstrom_message	*msg;
 	cl_program		program;
 	cl_mem			m_chunk;
+	cl_mem			m_kparams;	/* read-only clone of the parambuf */
+	cl_mem			m_rindex;	/* valid only if radix-sort path */
+	cl_mem			m_hist;		/* valid only if radix-sort path */
+	cl_mem			m_sync;		/* valid only if persistent kernel */
 	cl_kernel	   *prep_kernel;
 	cl_kernel	   *sort_kernel;
 	cl_int			dindex;
@@ -2040,6 +2368,9 @@ typedef struct
 	cl_int			sort_nums;
 	Size			bytes_dma_send;
 	Size			bytes_dma_recv;
+	cl_int			ev_head_nums;	/* number of initial DMA events on
+									 * m_chunk; the setup kernels depend
+									 * on all of them */
 	cl_int			ev_index;
 	cl_event		events[20];
 } clstate_gpusort_single;
@@ -2125,6 +2456,14 @@ clserv_respond_gpusort_single(cl_event event, cl_int ev_status, void *private)
 	for (i=0; i < clgss->sort_nums; i++)
 		clReleaseKernel(clgss->sort_kernel[i]);
 	clReleaseMemObject(clgss->m_chunk);
+	if (clgss->m_kparams)
+		clReleaseMemObject(clgss->m_kparams);
+	if (clgss->m_rindex)
+		clReleaseMemObject(clgss->m_rindex);
+	if (clgss->m_hist)
+		clReleaseMemObject(clgss->m_hist);
+	if (clgss->m_sync)
+		clReleaseMemObject(clgss->m_sync);
 
 	free(clgss->prep_kernel);
 	free(clgss->sort_kernel);
@@ -2159,8 +2498,8 @@ clserv_respond_gpusort_shmem(cl_event event, cl_int ev_status, void *private)
  * gpusort_setup_chunk_rs(cl_uint rcs_gindex,
  *                        __global kern_gpusort *kgpusort,
  *                        __global kern_row_store *krs,
- *                        cl_uint src_nitems,
- *                        __global cl_int *src_rindex,
+ *                        cl_int krs_nitems,
+ *                        cl_uint kcs_base,
  *                        __local void *local_workmem)
  */
 static cl_kernel
@@ -2168,9 +2507,11 @@ clserv_launch_gpusort_setup_row(clstate_gpusort_single *clgss,
 								tcache_row_store *trs,
 								cl_uint rcs_gindex,
 								cl_int src_nitems,
-								cl_int *src_rindex)
+								cl_int *src_rindex,
+								cl_uint kcs_base)
 {
 	cl_command_queue kcmdq = opencl_cmdq[clgss->dindex];
+	cl_command_queue dmaq = opencl_dmaq[clgss->dindex];
 	cl_kernel		prep_kernel;
 	cl_mem			m_rstore;
 	size_t			length;
@@ -2212,7 +2553,7 @@ clserv_launch_gpusort_setup_row(clstate_gpusort_single *clgss,
 									   !src_rindex
 									   ? trs->kern.nrows
 									   : src_nitems,
-									   sizeof(cl_uint)))
+									   sizeof(cl_ulong)))
 		goto error_2;
 
 	rc = clSetKernelArg(prep_kernel,
@@ -2256,8 +2597,18 @@ clserv_launch_gpusort_setup_row(clstate_gpusort_single *clgss,
 	}
 
 	rc = clSetKernelArg(prep_kernel,
-						4,	/* local_workmem */
-						sizeof(cl_uint) * (lwork_sz + 1),
+						4,	/* cl_uint kcs_base */
+						sizeof(cl_uint),
+						&kcs_base);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_2;
+	}
+
+	rc = clSetKernelArg(prep_kernel,
+						5,	/* local_workmem */
+						sizeof(cl_ulong) * (lwork_sz + 1),
 						NULL);
 	if (rc != CL_SUCCESS)
 	{
@@ -2268,13 +2619,13 @@ clserv_launch_gpusort_setup_row(clstate_gpusort_single *clgss,
 	/*
 	 * Send contents of row-store
 	 */
-	rc = clEnqueueWriteBuffer(kcmdq,
+	rc = clEnqueueWriteBuffer(dmaq,
 							  m_rstore,
 							  CL_FALSE,
 							  0,
 							  trs->kern.length,
 							  &trs->kern,
-							  2,
+							  clgss->ev_head_nums,
 							  &clgss->events[0],
 							  &clgss->events[clgss->ev_index]);
 	if (rc != CL_SUCCESS)
@@ -2291,13 +2642,13 @@ clserv_launch_gpusort_setup_row(clstate_gpusort_single *clgss,
 	 */
 	if (src_rindex && src_nitems > 0)
 	{
-		rc = clEnqueueWriteBuffer(kcmdq,
+		rc = clEnqueueWriteBuffer(dmaq,
 								  m_rstore,
 								  CL_FALSE,
 								  STROMALIGN(trs->kern.length),
 								  sizeof(cl_uint) * src_nitems,
 								  src_rindex,
-								  2,
+								  clgss->ev_head_nums,
 								  &clgss->events[0],
 								  &clgss->events[clgss->ev_index]);
 		if (rc != CL_SUCCESS)
@@ -2361,10 +2712,10 @@ error_0:
  *
  * __kernel void
  * gpusort_setup_chunk_cs(cl_uint rcs_gindex,
- *                        __global kern_gpusort *kgpusort,
- *                        __global kern_row_store *krs,
- *                        cl_uint src_nitems,
- *                        __global cl_int *src_rindex,
+ *                        __global kern_gpusort *kgsort,
+ *                        __global kern_column_store *kcs_src,
+ *                        cl_int src_nitems,
+ *                        cl_uint kcs_base,
  *                        __local void *local_workmem)
  */
 static cl_kernel
@@ -2373,10 +2724,12 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
 								   cl_uint rcs_gindex,
 								   cl_int src_nitems,
 								   cl_int *src_rindex,
+								   cl_uint kcs_base,
 								   bytea *kparam_0,
 								   bytea *kparam_1)
 {
 	cl_command_queue	kcmdq = opencl_cmdq[clgss->dindex];
+	cl_command_queue	dmaq = opencl_dmaq[clgss->dindex];
 	kern_column_store  *kcs_tmpl;
 	kern_column_store  *kcs_head;
 	kern_toastbuf	   *ktoast_head;
@@ -2459,13 +2812,18 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
 			break;
 	}
 	/*
-	 * growid and rindex of the source kcs; kern_column_to_column assumes
-	 * source and destination column-store are symmetric, so we need to
-	 * assign a certain amount of region even if it is not actually in-use.
+	 * encoded keys, growid and rindex of the source kcs;
+	 * kern_column_to_column assumes source and destination column-store
+	 * are symmetric, so we need to assign a certain amount of region
+	 * even if it is not actually in-use.
 	 */
 	kcs_head->colmeta[i_col].cs_ofs = kcs_offset;
 	ktoast_head->coldir[i_col] = (cl_uint)(-1);
 	i_col++;
+
+	kcs_head->colmeta[i_col].cs_ofs = kcs_offset;
+	ktoast_head->coldir[i_col] = (cl_uint)(-1);
+	i_col++;
 	//kcs_offset += STROMALIGN(sizeof(cl_long) * src_nitems);
 
 	kcs_head->colmeta[i_col].cs_ofs = kcs_offset;
@@ -2507,7 +2865,7 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
                                        !src_rindex
                                        ? kcs_nitems
                                        : src_nitems,
-                                       sizeof(cl_uint)))
+                                       sizeof(cl_ulong)))
 		goto error_release;
 
 	/* OK, setting up kernel arguments */
@@ -2552,8 +2910,18 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
 	}
 
 	rc = clSetKernelArg(prep_kernel,
-						4,	/* local_workmem */
-						sizeof(cl_uint) * (lwork_sz + 1),
+						4,	/* cl_uint kcs_base */
+						sizeof(cl_uint),
+						&kcs_base);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_release;
+	}
+
+	rc = clSetKernelArg(prep_kernel,
+						5,	/* local_workmem */
+						sizeof(cl_ulong) * (lwork_sz + 1),
 						NULL);
 	if (rc != CL_SUCCESS)
 	{
@@ -2566,16 +2934,24 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
 	 */
 	ev_index_base = clgss->ev_index;
 
-	/* kcs_head - header portion of kern_column_store */
+	/* kcs_head - header portion of kern_column_store
+	 *
+	 * The transfer queue is out-of-order capable, and the kernel below
+	 * waits on the events of this function only, so this first write
+	 * takes the initial writes on m_chunk (kparams, header of kcs and
+	 * status block) as its dependency; it transitively orders them in
+	 * front of the kernel that references their contents, like the
+	 * row-store path does.
+	 */
 	length = offsetof(kern_column_store, colmeta[ncols]);
-	rc = clEnqueueWriteBuffer(kcmdq,
+	rc = clEnqueueWriteBuffer(dmaq,
 							  m_cstore,
 							  CL_FALSE,
 							  0,
 							  length,
 							  kcs_head,
-							  0,
-							  NULL,
+							  clgss->ev_head_nums,
+							  &clgss->events[0],
 							  &clgss->events[clgss->ev_index]);
 	if (rc != CL_SUCCESS)
 	{
@@ -2589,7 +2965,7 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
 	/* ktoast_head - header portion of kern_toastbuf */
 	length = offsetof(kern_toastbuf, coldir[ncols]);
 	offset = kcs_head->length;
-	rc = clEnqueueWriteBuffer(kcmdq,
+	rc = clEnqueueWriteBuffer(dmaq,
 							  m_cstore,
 							  CL_FALSE,
 							  offset,
@@ -2623,7 +2999,7 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
 			length = (kcs_nitems + BITS_PER_BYTE - 1) / BITS_PER_BYTE;
 			if (tcs->cdata[i].isnull)
 			{
-				rc = clEnqueueWriteBuffer(kcmdq,
+				rc = clEnqueueWriteBuffer(dmaq,
 										  m_cstore,
 										  CL_FALSE,
 										  offset,
@@ -2643,7 +3019,7 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
 			{
 				cl_uint	nullmap = (cl_uint)(-1);
 
-				rc = clEnqueueFillBuffer(kcmdq,
+				rc = clEnqueueFillBuffer(dmaq,
 										 m_cstore,
 										 &nullmap,
 										 sizeof(cl_uint),
@@ -2667,7 +3043,7 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
 		length = (colmeta->attlen > 0
 				  ? colmeta->attlen
 				  : sizeof(cl_uint)) * kcs_nitems;
-		rc = clEnqueueWriteBuffer(kcmdq,
+		rc = clEnqueueWriteBuffer(dmaq,
 								  m_cstore,
 								  CL_FALSE,
 								  offset,
@@ -2691,7 +3067,7 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
 			Assert(colmeta->attlen < 0);
 			offset = kcs_head->length + ktoast_head->coldir[i_col];
 			length = tcs->cdata[i].toast->tbuf_usage;
-			rc = clEnqueueWriteBuffer(kcmdq,
+			rc = clEnqueueWriteBuffer(dmaq,
 									  m_cstore,
 									  CL_FALSE,
 									  offset,
@@ -2722,7 +3098,7 @@ clserv_launch_gpusort_setup_column(clstate_gpusort_single *clgss,
 
 		offset = colmeta->cs_ofs;
 		length = sizeof(cl_uint) * src_nitems;
-		rc = clEnqueueWriteBuffer(kcmdq,
+		rc = clEnqueueWriteBuffer(dmaq,
 								  m_cstore,
 								  CL_FALSE,
 								  offset,
@@ -2799,9 +3175,13 @@ error_release:
  * opencl kernel invocation of:
  *
  * __kernel void
- * gpusort_single(cl_int bitonic_unitsz,
- *                __global kern_gpusort *kgsort,
- *                __local void *local_workbuf)
+ * gpusort_single_step_fwd(cl_uint unitsz_log2,
+ *                         __constant kern_parambuf *kparams,
+ *                         __global kern_gpusort *kgsort,
+ *                         __local void *local_workbuf)
+ * or gpusort_single_step_rev with same arguments; the direction of
+ * the sub-stage selects the entrypoint, so the device code treats it
+ * as a compile-time constant.
  */
 static cl_kernel
 clserv_launch_gpusort_bitonic_step(clstate_gpusort_single *clgss,
@@ -2814,11 +3194,12 @@ clserv_launch_gpusort_bitonic_step(clstate_gpusort_single *clgss,
 	size_t		gwork_sz;
 	size_t		unitlen;
 	size_t		n_threads;
-	cl_int		bitonic_unitsz;
 	cl_int		rc;
 
 	sort_kernel = clCreateKernel(clgss->program,
-								 "gpusort_single_step",
+								 reversing
+								 ? "gpusort_single_step_rev"
+								 : "gpusort_single_step_fwd",
 								 &rc);
 	if (rc != CL_SUCCESS)
 	{
@@ -2838,16 +3219,20 @@ clserv_launch_gpusort_bitonic_step(clstate_gpusort_single *clgss,
 
 	//clserv_log("kernel call (nrows=%u, unitlen=%zu, lworksz=%zu, gworksz=%zu)", nrows, unitlen, lwork_sz, gwork_sz);
 
-	/* pack reversing and unitsz into one argument */
-	if (reversing)
-		bitonic_unitsz = -unitsz;
-	else
-		bitonic_unitsz = unitsz;
+	rc = clSetKernelArg(sort_kernel,
+						0,	/* cl_uint unitsz_log2 */
+						sizeof(cl_uint),
+						&unitsz);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
 
 	rc = clSetKernelArg(sort_kernel,
-						0,	/* cl_int bitonic_unitsz */
-						sizeof(cl_int),
-						&bitonic_unitsz);
+						1,	/* __constant kern_parambuf *kparams */
+						sizeof(cl_mem),
+						&clgss->m_kparams);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
@@ -2855,7 +3240,7 @@ clserv_launch_gpusort_bitonic_step(clstate_gpusort_single *clgss,
 	}
 
 	rc = clSetKernelArg(sort_kernel,
-						1,	/* kern_gpusort *kgsort */
+						2,	/* kern_gpusort *kgsort */
 						sizeof(cl_mem),
 						&clgss->m_chunk);
 	if (rc != CL_SUCCESS)
@@ -2865,7 +3250,7 @@ clserv_launch_gpusort_bitonic_step(clstate_gpusort_single *clgss,
 	}
 
 	rc = clSetKernelArg(sort_kernel,
-						2,	/* void *local_workbuf */
+						3,	/* void *local_workbuf */
 						sizeof(cl_int) * lwork_sz,
 						NULL);
 	if (rc != CL_SUCCESS)
@@ -2930,7 +3315,17 @@ clserv_launch_gpusort_bitonic_marge(clstate_gpusort_single *clgss,
 	// clserv_log("kernel call (nrows=%u, unitlen=%zu, lworksz=%zu, gworksz=%zu)", nrows, unitlen, lwork_sz, gwork_sz);
 
 	rc = clSetKernelArg(sort_kernel,
-						0,	/* kern_gpusort *kgsort */
+						0,	/* __constant kern_parambuf *kparams */
+						sizeof(cl_mem),
+						&clgss->m_kparams);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						1,	/* kern_gpusort *kgsort */
 						sizeof(cl_mem),
 						&clgss->m_chunk);
 	if (rc != CL_SUCCESS)
@@ -2940,7 +3335,7 @@ clserv_launch_gpusort_bitonic_marge(clstate_gpusort_single *clgss,
 	}
 
 	rc = clSetKernelArg(sort_kernel,
-						1,	/* void *local_workbuf */
+						2,	/* void *local_workbuf */
 						sizeof(cl_int) * lwork_sz * 2,
 						NULL);
 	if (rc != CL_SUCCESS)
@@ -2976,6 +3371,90 @@ error_0:
 	return NULL;
 }
 
+/*
+ * opencl kernel invocation of:
+ *
+ * __kernel void
+ * gpusort_single_local(__constant kern_parambuf *kparams,
+ *                      __global kern_gpusort *kgsort)
+ *
+ * Unlike gpusort_single_marge, its workgroup size is fixed at the
+ * compile time (GPUSORT_LOCAL_WORKSZ), and its local working buffer
+ * is statically allocated in the kernel, so we don't deliver dynamic
+ * local memory here.
+ */
+static cl_kernel
+clserv_launch_gpusort_bitonic_local(clstate_gpusort_single *clgss,
+									cl_uint nrows, bool is_first)
+{
+	cl_command_queue kcmdq = opencl_cmdq[clgss->dindex];
+	cl_kernel	sort_kernel;
+	size_t		lwork_sz;
+	size_t		gwork_sz;
+	size_t		unitlen;
+	cl_int		rc;
+
+	sort_kernel = clCreateKernel(clgss->program,
+								 "gpusort_single_local",
+								 &rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
+		goto error_0;
+	}
+
+	/* workgroup size is declared by reqd_work_group_size() */
+	unitlen  = 2 * GPUSORT_LOCAL_WORKSZ;
+	lwork_sz = GPUSORT_LOCAL_WORKSZ;
+	gwork_sz = ((nrows + unitlen - 1) & ~(unitlen - 1)) / 2;
+
+	rc = clSetKernelArg(sort_kernel,
+						0,	/* __constant kern_parambuf *kparams */
+						sizeof(cl_mem),
+						&clgss->m_kparams);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						1,	/* kern_gpusort *kgsort */
+						sizeof(cl_mem),
+						&clgss->m_chunk);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clEnqueueNDRangeKernel(kcmdq,
+								sort_kernel,
+								1,
+								NULL,
+								&gwork_sz,
+								&lwork_sz,
+								is_first ? clgss->ev_index : 1,
+								is_first
+								? &clgss->events[0]
+								: &clgss->events[clgss->ev_index - 1],
+								&clgss->events[clgss->ev_index]);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clEnqueueNDRangeKernel: %s",
+				   opencl_strerror(rc));
+		goto error_1;
+	}
+	clgss->ev_index++;
+
+	return sort_kernel;
+
+error_1:
+	clReleaseKernel(sort_kernel);
+error_0:
+	return NULL;
+}
+
 static cl_kernel
 clserv_launch_gpusort_bitonic_sort(clstate_gpusort_single *clgss,
 								   cl_uint nrows, cl_uint unitsz,
@@ -3005,7 +3484,17 @@ clserv_launch_gpusort_bitonic_sort(clstate_gpusort_single *clgss,
 	// clserv_log("kernel call (nrows=%u, unitlen=%zu, lworksz=%zu, gworksz=%zu)", nrows, unitlen, lwork_sz, gwork_sz);
 
 	rc = clSetKernelArg(sort_kernel,
-						0,	/* kern_gpusort *kgsort */
+						0,	/* __constant kern_parambuf *kparams */
+						sizeof(cl_mem),
+						&clgss->m_kparams);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						1,	/* kern_gpusort *kgsort */
 						sizeof(cl_mem),
 						&clgss->m_chunk);
 	if (rc != CL_SUCCESS)
@@ -3015,7 +3504,7 @@ clserv_launch_gpusort_bitonic_sort(clstate_gpusort_single *clgss,
 	}
 
 	rc = clSetKernelArg(sort_kernel,
-						1,	/* void *local_workbuf */
+						2,	/* void *local_workbuf */
 						sizeof(cl_int) * lwork_sz * 2,
 						NULL);
 	if (rc != CL_SUCCESS)
@@ -3051,19 +3540,463 @@ error_0:
 	return NULL;
 }
 
-static void
-clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
+/*
+ * opencl kernel invocation of:
+ *
+ * __kernel void
+ * gpusort_single_persistent(__constant kern_parambuf *kparams,
+ *                           __global kern_gpusort *kgsort,
+ *                           volatile __global cl_uint *sync_count,
+ *                           __local void *local_workbuf)
+ *
+ * It runs whole of the bitonic network on a single invocation; the
+ * inter-workgroup barrier in the kernel assumes all the workgroups
+ * are resident on the device simultaneously, so we launch just one
+ * workgroup per compute unit and the kernel walks on the compare-swap
+ * positions with a grid-stride loop instead.
+ */
+static cl_kernel
+clserv_launch_gpusort_single_persistent(clstate_gpusort_single *clgss)
 {
-	pgstrom_gpusort_chunk  *gs_chunk;
-	kern_parambuf		   *kparams;
-	bytea				   *kparam_0;
-	bytea				   *kparam_1;
-	kern_column_store	   *kcs;
-	clstate_gpusort_single *clgss;
-	cl_command_queue		kcmdq;
-	cl_int				   *rindex;
-	cl_uint					dindex;
-	cl_uint					nrows;
+	cl_command_queue kcmdq = opencl_cmdq[clgss->dindex];
+	const pgstrom_device_info *devinfo =
+		pgstrom_get_device_info(clgss->dindex);
+	cl_kernel	sort_kernel;
+	size_t		lwork_sz;
+	size_t		gwork_sz;
+	cl_uint		sync_init = 0;
+	cl_int		rc;
+
+	sort_kernel = clCreateKernel(clgss->program,
+								 "gpusort_single_persistent",
+								 &rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
+		goto error_0;
+	}
+
+	/* workgroup size is declared by reqd_work_group_size() */
+	lwork_sz = GPUSORT_LOCAL_WORKSZ;
+	gwork_sz = lwork_sz * devinfo->dev_max_compute_units;
+
+	/* counter of the inter-workgroup barrier, begins from zero */
+	clgss->m_sync = clCreateBuffer(opencl_context,
+								   CL_MEM_READ_WRITE |
+								   CL_MEM_COPY_HOST_PTR,
+								   sizeof(cl_uint),
+								   &sync_init,
+								   &rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						0,	/* __constant kern_parambuf *kparams */
+						sizeof(cl_mem),
+						&clgss->m_kparams);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						1,	/* kern_gpusort *kgsort */
+						sizeof(cl_mem),
+						&clgss->m_chunk);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						2,	/* cl_uint *sync_count */
+						sizeof(cl_mem),
+						&clgss->m_sync);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						3,	/* void *local_workbuf */
+						sizeof(cl_int) * lwork_sz,
+						NULL);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	/* it is the only sorting kernel; synchronizes all the preparations */
+	rc = clEnqueueNDRangeKernel(kcmdq,
+								sort_kernel,
+								1,
+								NULL,
+								&gwork_sz,
+								&lwork_sz,
+								clgss->ev_index,
+								&clgss->events[0],
+								&clgss->events[clgss->ev_index]);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clEnqueueNDRangeKernel: %s",
+				   opencl_strerror(rc));
+		goto error_1;
+	}
+	clgss->ev_index++;
+
+	return sort_kernel;
+
+error_1:
+	clReleaseKernel(sort_kernel);
+error_0:
+	return NULL;
+}
+
+/*
+ * opencl kernel invocation of gpusort_radix_hist / gpusort_radix_reorder;
+ * both of them take an identical argument list and workgroup geometry,
+ * so we share a common launcher that switches the kernel function name.
+ */
+static cl_kernel
+clserv_launch_gpusort_radix_pass(clstate_gpusort_single *clgss,
+								 const char *kfunc_name,
+								 cl_uint nrows,
+								 cl_int digit_shift,
+								 cl_int src_is_alt,
+								 bool is_first)
+{
+	cl_command_queue kcmdq = opencl_cmdq[clgss->dindex];
+	cl_kernel	sort_kernel;
+	size_t		lwork_sz;
+	size_t		gwork_sz;
+	size_t		ngroups;
+	cl_int		rc;
+
+	sort_kernel = clCreateKernel(clgss->program,
+								 kfunc_name,
+								 &rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
+		goto error_0;
+	}
+
+	/* workgroup size is declared by reqd_work_group_size() */
+	ngroups  = (nrows + GPUSORT_RADIX_WORKSZ - 1) / GPUSORT_RADIX_WORKSZ;
+	lwork_sz = GPUSORT_RADIX_WORKSZ;
+	gwork_sz = ngroups * GPUSORT_RADIX_WORKSZ;
+
+	rc = clSetKernelArg(sort_kernel,
+						0,	/* cl_int digit_shift */
+						sizeof(cl_int),
+						&digit_shift);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						1,	/* cl_int src_is_alt */
+						sizeof(cl_int),
+						&src_is_alt);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						2,	/* kern_gpusort *kgsort */
+						sizeof(cl_mem),
+						&clgss->m_chunk);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						3,	/* cl_int *rindex_alt */
+						sizeof(cl_mem),
+						&clgss->m_rindex);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						4,	/* cl_uint *pass_hist */
+						sizeof(cl_mem),
+						&clgss->m_hist);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clEnqueueNDRangeKernel(kcmdq,
+								sort_kernel,
+								1,
+								NULL,
+								&gwork_sz,
+								&lwork_sz,
+								is_first ? clgss->ev_index : 1,
+								is_first
+								? &clgss->events[0]
+								: &clgss->events[clgss->ev_index - 1],
+								&clgss->events[clgss->ev_index]);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clEnqueueNDRangeKernel: %s",
+				   opencl_strerror(rc));
+		goto error_1;
+	}
+	clgss->ev_index++;
+
+	return sort_kernel;
+
+error_1:
+	clReleaseKernel(sort_kernel);
+error_0:
+	return NULL;
+}
+
+/*
+ * opencl kernel invocation of:
+ *
+ * __kernel void
+ * gpusort_radix_scan(cl_uint num_parts,
+ *                    __global cl_uint *pass_hist)
+ *
+ * It runs on a single workgroup; each thread takes care of one digit.
+ */
+static cl_kernel
+clserv_launch_gpusort_radix_scan(clstate_gpusort_single *clgss,
+								 cl_uint ngroups)
+{
+	cl_command_queue kcmdq = opencl_cmdq[clgss->dindex];
+	cl_kernel	sort_kernel;
+	size_t		lwork_sz;
+	size_t		gwork_sz;
+	cl_int		rc;
+
+	sort_kernel = clCreateKernel(clgss->program,
+								 "gpusort_radix_scan",
+								 &rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
+		goto error_0;
+	}
+
+	/* a single workgroup, fixed by reqd_work_group_size() */
+	lwork_sz = GPUSORT_RADIX_WORKSZ;
+	gwork_sz = GPUSORT_RADIX_WORKSZ;
+
+	rc = clSetKernelArg(sort_kernel,
+						0,	/* cl_uint num_parts */
+						sizeof(cl_uint),
+						&ngroups);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clSetKernelArg(sort_kernel,
+						1,	/* cl_uint *pass_hist */
+						sizeof(cl_mem),
+						&clgss->m_hist);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetKernelArg: %s", opencl_strerror(rc));
+		goto error_1;
+	}
+
+	rc = clEnqueueNDRangeKernel(kcmdq,
+								sort_kernel,
+								1,
+								NULL,
+								&gwork_sz,
+								&lwork_sz,
+								1,
+								&clgss->events[clgss->ev_index - 1],
+								&clgss->events[clgss->ev_index]);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clEnqueueNDRangeKernel: %s",
+				   opencl_strerror(rc));
+		goto error_1;
+	}
+	clgss->ev_index++;
+
+	return sort_kernel;
+
+error_1:
+	clReleaseKernel(sort_kernel);
+error_0:
+	return NULL;
+}
+
+/*
+ * clserv_launch_gpusort_radix
+ *
+ * It enqueues a sequence of least-significant-digit radix passes that
+ * replaces the bitonic network when the planner detected a single
+ * fixed-width integer sort key without NULLs. The encoded keys were
+ * already materialized on the sorting chunk by the setup kernels (see
+ * gpusort_keyenc), then each byte of the key takes one (histogram,
+ * scan, reorder) round that scatters the result index back and forth
+ * between the in-chunk array and an alternate buffer.
+ * Prior to the passes, the key range reduced during the setup (see
+ * gpusort_keyrange_update) is fetched; the passes on the key bytes it
+ * proves constant would distribute all the rows into a single bucket,
+ * so they are simply cut. The number of passes is kept an even number
+ * (the full key width is 2, 4 or 8 bytes), so the final pass always
+ * ends up in the in-chunk array as the write-back expects.
+ */
+static bool
+clserv_launch_gpusort_radix(clstate_gpusort_single *clgss,
+							cl_uint nrows,
+							cl_int key_attlen)
+{
+	pgstrom_gpusort *gpusort = (pgstrom_gpusort *)clgss->msg;
+	pgstrom_gpusort_chunk *gs_chunk;
+	cl_kernel	sort_kernel;
+	cl_ulong	keyrange[2];
+	Size		offset;
+	cl_uint		ngroups;
+	cl_int		num_passes = key_attlen;
+	cl_int		k = 0;
+	cl_int		pass;
+	cl_int		rc;
+
+	Assert(key_attlen == 2 || key_attlen == 4 || key_attlen == 8);
+	ngroups = (nrows + GPUSORT_RADIX_WORKSZ - 1) / GPUSORT_RADIX_WORKSZ;
+
+	/*
+	 * A small synchronous read-back of the key range the setup kernels
+	 * reduced. It has to wait for completion of all the preparation
+	 * events anyway, like the first radix pass does, and 16 bytes of
+	 * DMA are nothing compared to a kernel launch. An unknown range
+	 * (min > max; the device lacks 64bit atomics) keeps the full
+	 * number of passes; an even number of passes is kept in any case,
+	 * see the note on the function.
+	 */
+	gs_chunk = dlist_container(pgstrom_gpusort_chunk, chain,
+							   dlist_head_node(&gpusort->gs_chunks));
+	offset = ((uintptr_t)KERN_GPUSORT_KEYRANGE(&gs_chunk->kern) -
+			  (uintptr_t)(&gs_chunk->kern));
+	rc = clEnqueueReadBuffer(opencl_dmaq[clgss->dindex],
+							 clgss->m_chunk,
+							 CL_TRUE,
+							 offset,
+							 sizeof(keyrange),
+							 keyrange,
+							 clgss->ev_index,
+							 &clgss->events[0],
+							 NULL);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clEnqueueReadBuffer: %s", opencl_strerror(rc));
+		return false;
+	}
+	clgss->bytes_dma_recv += sizeof(keyrange);
+
+	if (keyrange[0] <= keyrange[1])
+	{
+		cl_ulong	kdiff = keyrange[0] ^ keyrange[1];
+
+		num_passes = 0;
+		while (kdiff != 0)
+		{
+			num_passes++;
+			kdiff >>= GPUSORT_RADIX_BITS;
+		}
+		num_passes = TYPEALIGN(2, num_passes);
+		Assert(num_passes <= key_attlen);
+	}
+
+	/* working buffers of the radix passes */
+	clgss->m_rindex = clCreateBuffer(opencl_context,
+									 CL_MEM_READ_WRITE,
+									 sizeof(cl_int) * nrows,
+									 NULL,
+									 &rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
+		return false;
+	}
+	clgss->m_hist = clCreateBuffer(opencl_context,
+								   CL_MEM_READ_WRITE,
+								   sizeof(cl_uint) * GPUSORT_RADIX_SLOTS *
+								   ngroups,
+								   NULL,
+								   &rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
+		return false;
+	}
+
+	for (pass=0; pass < num_passes; pass++)
+	{
+		cl_int	digit_shift = GPUSORT_RADIX_BITS * pass;
+		cl_int	src_is_alt = (pass & 1);
+
+		sort_kernel = clserv_launch_gpusort_radix_pass(clgss,
+													   "gpusort_radix_hist",
+													   nrows,
+													   digit_shift,
+													   src_is_alt,
+													   pass == 0);
+		if (!sort_kernel)
+			return false;
+		clgss->sort_kernel[k++] = sort_kernel;
+
+		sort_kernel = clserv_launch_gpusort_radix_scan(clgss, ngroups);
+		if (!sort_kernel)
+			return false;
+		clgss->sort_kernel[k++] = sort_kernel;
+
+		sort_kernel = clserv_launch_gpusort_radix_pass(clgss,
+													   "gpusort_radix_reorder",
+													   nrows,
+													   digit_shift,
+													   src_is_alt,
+													   false);
+		if (!sort_kernel)
+			return false;
+		Assert(k <= clgss->sort_nums);
+		clgss->sort_kernel[k++] = sort_kernel;
+	}
+	return true;
+}
+
+static void
+clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
+{
+	pgstrom_gpusort_chunk  *gs_chunk;
+	kern_parambuf		   *kparams;
+	bytea				   *kparam_0;
+	bytea				   *kparam_1;
+	kern_column_store	   *kcs;
+	clstate_gpusort_single *clgss;
+	cl_command_queue		dmaq;
+	cl_int				   *rindex;
+	cl_uint					dindex;
+	cl_uint					nrows;
+	cl_uint					kcs_base;
 	cl_uint					prep_nums;
 	cl_uint					sort_nums;
 	cl_uint					sort_size;
@@ -3108,6 +4041,9 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 	}
 	sort_size = get_next_log2(nrows);
 	sort_nums = (sort_size * (sort_size + 1)) / 2;
+	/* radix sorting takes 3 * (key width) kernels instead */
+	if (gpusort->radix_attlen > 0)
+		sort_nums = Max(sort_nums, 3 * gpusort->radix_attlen);
 
 	/* state object of gpuscan (single chunk) */
 	event_nums = 3 * prep_nums + sort_nums + 4 + 10000;
@@ -3129,7 +4065,7 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 	 */
 	dindex = pgstrom_opencl_device_schedule(&gpusort->msg);
 	clgss->dindex = dindex;
-	kcmdq = opencl_cmdq[dindex];
+	dmaq = opencl_dmaq[dindex];
 
 	/*
 	 * First of all, it looks up a program object to be run on
@@ -3182,16 +4118,42 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 		goto error_sync;
 	}
 
+	/*
+	 * Also, a read-only clone of the parambuf for the sorting kernels;
+	 * they take it as __constant argument, so the small read-mostly
+	 * parameters are broadcasted from the constant cache, not from
+	 * the L1/L2 path shared with results[] traffic.
+	 */
+	clgss->m_kparams = clCreateBuffer(opencl_context,
+									  CL_MEM_READ_ONLY |
+									  CL_MEM_COPY_HOST_PTR,
+									  KERN_GPUSORT_PARAMBUF_LENGTH(&gs_chunk->kern),
+									  kparams,
+									  &rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
+		goto error_sync;
+	}
+
 	/*
 	 * Send header portion of kparam, kcs, status and toast buffer.
 	 * Note that role of the kernel is to set up contents of kcs
 	 * and toast buffer, so no need to translate the contents itself
 	 */
 
+	/*
+	 * Number of rows is already known here, so we put it on the chunk
+	 * header prior to the DMA send; the setup kernels derive their
+	 * destination range from the base offset given as kernel argument,
+	 * and never count up kcs->nrows by atomic operations.
+	 */
+	kcs->nrows = nrows;
+
 	/* kparam + header of kern_column_store */
 	length = (KERN_GPUSORT_PARAMBUF_LENGTH(&gs_chunk->kern) +
 			  STROMALIGN(offsetof(kern_column_store, colmeta[kcs->ncols])));
-	rc = clEnqueueWriteBuffer(kcmdq,
+	rc = clEnqueueWriteBuffer(dmaq,
 							  clgss->m_chunk,
 							  CL_FALSE,
 							  0,
@@ -3210,12 +4172,12 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 	clgss->bytes_dma_send += length;
 
 	/* rindex array */
-	if (gpusort->has_rindex)
+	if (gpusort->has_rindex && kcs->nrows > 0)
 	{
 		rindex = KERN_GPUSORT_RESULT_INDEX(kcs);
 		length = sizeof(cl_uint) * kcs->nrows;
 		offset = (uintptr_t)rindex - (uintptr_t)(&gs_chunk->kern);
-		rc = clEnqueueWriteBuffer(kcmdq,
+		rc = clEnqueueWriteBuffer(dmaq,
 								  clgss->m_chunk,
 								  CL_FALSE,
 								  offset,
@@ -3239,7 +4201,7 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 			  STROMALIGN(offsetof(kern_toastbuf, coldir[0])));
 	offset = ((uintptr_t)KERN_GPUSORT_STATUS(&gs_chunk->kern) -
 			  (uintptr_t)(&gs_chunk->kern));
-	rc = clEnqueueWriteBuffer(kcmdq,
+	rc = clEnqueueWriteBuffer(dmaq,
 							  clgss->m_chunk,
 							  CL_FALSE,
 							  offset,
@@ -3257,8 +4219,21 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 	clgss->bytes_dma_send += length;
 
 	/*
-	 * Preparation for each row-/column-store
+	 * All the writes above initialize the m_chunk buffer; the number of
+	 * their events varies with the rindex array, so the setup launchers
+	 * pick it up from here instead of assuming a constant. Every setup
+	 * kernel has to wait for all of them; in particular, the empty-range
+	 * initialization on the key range words must not overtake the
+	 * atom_min/atom_max publications of any setup workgroup.
+	 */
+	clgss->ev_head_nums = clgss->ev_index;
+
+	/*
+	 * Preparation for each row-/column-store; kcs_base tracks how many
+	 * rows the previous stores consume on the sorting chunk, and tells
+	 * each setup kernel its base offset.
 	 */
+	kcs_base = 0;
 	for (i=0; i < prep_nums; i++)
 	{
 		StromObject *sobject = gs_chunk->rcs_slot[i].rcstore;
@@ -3273,9 +4248,11 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 			prep_kernel = clserv_launch_gpusort_setup_row(clgss, trs,
 														  rcs_gindex,
 														  src_nitems,
-														  src_rindex);
+														  src_rindex,
+														  kcs_base);
 			if (!prep_kernel)
 				goto error_sync;
+			kcs_base += (src_rindex ? src_nitems : trs->kern.nrows);
 		}
 		else if (StromTagIs(sobject, TCacheColumnStore))
 		{
@@ -3284,10 +4261,12 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 															 rcs_gindex,
 															 src_nitems,
 															 src_rindex,
+															 kcs_base,
 															 kparam_0,
 															 kparam_1);
 			if (!prep_kernel)
 				goto error_sync;
+			kcs_base += (src_rindex ? src_nitems : tcs->nrows);
 		}
 		else
 		{
@@ -3296,12 +4275,28 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 		}
 		clgss->prep_kernel[i] = prep_kernel;
 	}
+	Assert(kcs_base == nrows);
 
 	/*
 	 * OK, preparation was done. Let's launch gpusort_single kernel
 	 * to sort key values within a gpusort-chunk.
 	 */
-	if (sort_size > 0)
+	if (sort_size > 0 && gpusort->radix_attlen > 0)
+	{
+		if (!clserv_launch_gpusort_radix(clgss, nrows,
+										 gpusort->radix_attlen))
+			goto error_sync;
+	}
+	else if (sort_size > 0 && gpusort->sort_persistent)
+	{
+		cl_kernel	sort_kernel
+			= clserv_launch_gpusort_single_persistent(clgss);
+
+		if (!sort_kernel)
+			goto error_sync;
+		clgss->sort_kernel[0] = sort_kernel;
+	}
+	else if (sort_size > 0)
 	{
 		/*
 		 * FIXME: optimal size estimation should be integrated to
@@ -3316,7 +4311,10 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 		size_t max_threads     = ((local_worksz < local_memsz/lmem_per_thread)
 								  ? local_worksz
 								  : (local_memsz/lmem_per_thread));
-		int max_sort_size      = LOG2(max_threads) + 1;
+		bool   local_fixed     = (max_threads >= GPUSORT_LOCAL_WORKSZ);
+		int max_sort_size      = (local_fixed
+								  ? LOG2(GPUSORT_LOCAL_WORKSZ) + 1
+								  : LOG2(max_threads) + 1);
 		cl_int k               = 0;
 
 		cl_kernel sort_kernel;
@@ -3341,9 +4339,13 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 					goto error_sync;
 				clgss->sort_kernel[k++] = sort_kernel;
 			}
-			sort_kernel = clserv_launch_gpusort_bitonic_marge(clgss, nrows,
-															  max_sort_size,
-															  false);
+			if (local_fixed)
+				sort_kernel = clserv_launch_gpusort_bitonic_local(clgss, nrows,
+																  false);
+			else
+				sort_kernel = clserv_launch_gpusort_bitonic_marge(clgss, nrows,
+																  max_sort_size,
+																  false);
 			if (!sort_kernel)
 				goto error_sync;
 			Assert(k <= sort_nums);
@@ -3358,7 +4360,7 @@ clserv_process_gpusort_single(pgstrom_gpusort *gpusort)
 			  KERN_GPUSORT_CHUNK_LENGTH(&gs_chunk->kern) +
 			  KERN_GPUSORT_STATUS_LENGTH(&gs_chunk->kern) +
 			  KERN_GPUSORT_TOASTBUF_LENGTH(&gs_chunk->kern));
-	rc = clEnqueueReadBuffer(kcmdq,
+	rc = clEnqueueReadBuffer(dmaq,
 							 clgss->m_chunk,
 							 CL_FALSE,
 							 0,
@@ -3423,6 +4425,14 @@ error_sync:
 	}
 	if (clgss->m_chunk)
 		clReleaseMemObject(clgss->m_chunk);
+	if (clgss->m_kparams)
+		clReleaseMemObject(clgss->m_kparams);
+	if (clgss->m_rindex)
+		clReleaseMemObject(clgss->m_rindex);
+	if (clgss->m_hist)
+		clReleaseMemObject(clgss->m_hist);
+	if (clgss->m_sync)
+		clReleaseMemObject(clgss->m_sync);
 	if (clgss->program)
 		clReleaseProgram(clgss->program);
 
@@ -51,6 +51,7 @@ cl_device_type		opencl_device_types = 0;
 cl_uint				opencl_num_devices;
 cl_device_id		opencl_devices[MAX_NUM_DEVICES];
 cl_command_queue	opencl_cmdq[MAX_NUM_DEVICES];
+cl_command_queue	opencl_dmaq[MAX_NUM_DEVICES];
 static List		   *opencl_valid_devices = NIL;
 
 /*
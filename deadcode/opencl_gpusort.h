@@ -56,9 +56,12 @@
  * is at most 4-5 chunks. A regular merge-sort is designed to sort two
  * preliminary sorted smaller array; usually stored in sequential devices.
  * We deal with GPU/MIC DRAM as if a small window towards whole of data set.
- * Let's assume Please assume we try to merge 
- *
- *
+ * Two sorted chunks are merged with the merge-path scheme; a partition
+ * kernel cuts the merged output into fixed size tiles and locates the
+ * source position of every tile boundary by binary search on the merge
+ * diagonal, then each workgroup produces one tile with a plain linear
+ * merge. Unlike a bitonic merging network, it takes O(x+y) comparisons
+ * and no padding of the inputs up to a power of two.
  */
 
 
@@ -82,15 +85,15 @@ typedef struct
 	 * variable length fields below
 	 * -----------------------------
 	 * kern_column_store	kchunk
-	 * cl_int				status
+	 * cl_int				status (+ min/max of the encoded sort keys)
 	 * kern_toastbuf		ktoast
 	 *
 	 * On gpusort_setup_chunk_(rs|cs), whole of the kern_gpusort shall
 	 * be written back.
 	 * On gpusort_single, result buffer (a part of kchunk) and status
 	 * shall be written back.
-	 * On gpusort_multi, whole of the kern_gpusort shall be written
-	 * back.
+	 * On gpusort_multi_merge, whole of the kern_gpusort of the both
+	 * destination chunks shall be written back.
 	 */
 } kern_gpusort;
 
@@ -111,8 +114,18 @@ typedef struct
 	((__global cl_int *)									\
 	 ((__global char *)KERN_GPUSORT_CHUNK(kgpusort) +		\
 	  KERN_GPUSORT_CHUNK_LENGTH(kgpusort)))
+/*
+ * minimum/maximum encoded sort keys of the chunk, reduced by the setup
+ * kernels; located just after the status word (one cl_ulong ahead to
+ * keep the 64bit alignment). [0] is the minimum, [1] the maximum;
+ * min > max means the range is unknown.
+ */
+#define KERN_GPUSORT_KEYRANGE(kgpusort)						\
+	((__global cl_ulong *)									\
+	 ((__global char *)KERN_GPUSORT_STATUS(kgpusort) +		\
+	  sizeof(cl_ulong)))
 #define KERN_GPUSORT_STATUS_LENGTH(kgpusort)				\
-	STROMALIGN(sizeof(cl_int))
+	STROMALIGN(3 * sizeof(cl_ulong))
 
 #define KERN_GPUSORT_TOASTBUF(kgpusort)						\
 	((__global kern_toastbuf *)								\
@@ -131,6 +144,11 @@ typedef struct
 	((__global cl_ulong *)								\
 	 ((__global char *)(kchunk) +						\
 	  (kchunk)->colmeta[(kchunk)->ncols - 2].cs_ofs))
+/* third last column of kchunk is the encoded sort keys */
+#define KERN_GPUSORT_SORTKEYS(kchunk)					\
+	((__global cl_ulong *)								\
+	 ((__global char *)(kchunk) +						\
+	  (kchunk)->colmeta[(kchunk)->ncols - 3].cs_ofs))
 
 
 #define KERN_GPUSORT_TOTAL_LENGTH(kchunk)		\
@@ -139,17 +157,94 @@ typedef struct
 	 KERN_GPUSORT_STATUS_LENGTH(kchunk) +		\
 	 KERN_GPUSORT_TOASTBUF_LENGTH(kchunk))
 
+/*
+ * Fixed local workgroup size of gpusort_single_local; one workgroup
+ * stages twice this number of result indexes onto local memory, then
+ * applies all the bitonic sub-stages that fit within the tile.
+ */
+#define GPUSORT_LOCAL_WORKSZ	256
+
+/*
+ * Definitions for LSD radix sorting; an alternative of bitonic sorting
+ * being chosen if the sort key is a single not-null fixed-width integer
+ * column. Each pass distributes the rows according to one byte of the
+ * key, from the least significant byte to the most significant one,
+ * so number of passes is attlen of the key column, not O(log^2 N).
+ */
+#define GPUSORT_RADIX_BITS		8
+#define GPUSORT_RADIX_SLOTS		(1 << GPUSORT_RADIX_BITS)
+#define GPUSORT_RADIX_WORKSZ	GPUSORT_RADIX_SLOTS
+
+/*
+ * Definitions for the inter-chunk merge; the merged output is cut into
+ * tiles of GPUSORT_MERGE_TILESZ rows, and one workgroup of
+ * GPUSORT_MERGE_WORKSZ threads is launched per tile. The tile size also
+ * decides the amount of local memory consumed by gpusort_multi_merge
+ * (three cl_int arrays and one cl_ulong array of the tile size), so
+ * don't enlarge it without checking CL_DEVICE_LOCAL_MEM_SIZE of the
+ * supported devices.
+ */
+#define GPUSORT_MERGE_TILESZ	1024
+#define GPUSORT_MERGE_WORKSZ	256
+/* put on the staged result indexes to track the origin of a merged row;
+ * harmless because nrooms of a chunk never gets close to 2^30 */
+#define GPUSORT_MERGE_YFLAG		(1 << 30)
+
 #ifdef OPENCL_DEVICE_CODE
+
+/* 64bit min/max atomics for the key-range reduction, if supported */
+#ifdef cl_khr_int64_extended_atomics
+#pragma OPENCL EXTENSION cl_khr_int64_extended_atomics : enable
+#endif
+
+/*
+ * comparison function - to be generated by PG-Strom on the fly.
+ * It is declared always_inline; a real function call would keep the
+ * whole set of argument registers alive on every call site within the
+ * innermost loops, and the extra register pressure directly reduces
+ * the number of threads resident per compute unit.
+ */
+static inline __attribute__((always_inline))
+cl_int gpusort_comp(__private int *errcode,
+					__global kern_column_store *kcs_x,
+					__global kern_toastbuf *ktoast_x,
+					__private cl_int x_index,
+					__global kern_column_store *kcs_y,
+					__global kern_toastbuf *ktoast_y,
+					__private cl_int y_index);
+
 /*
- * comparison function - to be generated by PG-Strom on the fly
+ * accessors of the reserved columns - also generated on the fly,
+ * together with gpusort_comp. Layout of the sorting chunk is fixed
+ * per query, so the generated definitions locate the arrays with
+ * offsets baked in as preprocessor constants; unlike the generic
+ * macros above, no colmeta[] lookup from global memory is needed on
+ * each reference. Don't use them on other column-stores than the
+ * sorting chunk itself.
  */
-static cl_int gpusort_comp(__private int *errcode,
-						   __global kern_column_store *kcs_x,
-						   __global kern_toastbuf *ktoast_x,
-						   __private cl_int x_index,
-						   __global kern_column_store *kcs_y,
-						   __global kern_toastbuf *ktoast_y,
-						   __private cl_int y_index);
+static __global cl_int *
+gpusort_result_index(__global kern_column_store *kchunk);
+static __global cl_ulong *
+gpusort_global_rowid(__global kern_column_store *kchunk);
+static __global cl_ulong *
+gpusort_keys(__global kern_column_store *kchunk);
+
+/*
+ * encoder of the sort keys - also generated on the fly. If the first
+ * sort key is a not-null fixed-width integer, it translates the key of
+ * the supplied row into an unsigned 64bit value that keeps the ordering
+ * of the original values (bits are flipped when descending order), and
+ * the setup kernels materialize it on the third last column of the
+ * sorting chunk. gpusort_comp() then decides the ordering by the first
+ * key with a single coalesced load per side; the radix passes also use
+ * this array as their digit source. Elsewhere, it returns zero for any
+ * row, so the fast path degenerates to a no-op tie.
+ */
+static cl_ulong
+gpusort_keyenc(__private cl_int *errcode,
+			   __global kern_column_store *kcs,
+			   __global kern_toastbuf *ktoast,
+			   cl_int index);
 
 
 
@@ -165,15 +260,15 @@ static cl_int gpusort_comp(__private int *errcode,
 /* expected kernel prototypes */
 static void
 run_gpusort_single_step(
-	__global kern_parambuf *kparams,
-	cl_bool reversing,					/* in */
-	cl_uint unitsz,						/* in */
+	__constant kern_parambuf *kparams,
+	cl_bool reversing,					/* in; a literal on each call site */
+	cl_uint unitsz_log2,				/* in */
 	__global kern_column_store *kchunk,	/* in */
 	__global kern_toastbuf *ktoast,		/* in */
 	__private cl_int *errcode			/* out */
 	)
 {
-	__global cl_int	*results = KERN_GPUSORT_RESULT_INDEX(kchunk);
+	__global cl_int	*results = gpusort_result_index(kchunk);
 	cl_int	nrows			 = (kchunk)->nrows;
 
 	/*
@@ -184,42 +279,77 @@ run_gpusort_single_step(
 	 */
 
 	cl_int	threadID		= get_global_id(0);
-	cl_int	halfUnitSize	= unitsz / 2;
-	cl_int	unitMask		= unitsz - 1;
+	cl_int	halfUnitSize	= 1 << (unitsz_log2 - 1);
+	cl_int	unitMask		= (1 << unitsz_log2) - 1;
 	cl_int	idx0;
 	cl_int	idx1;
 
-	idx0 = (threadID / halfUnitSize) * unitsz + threadID % halfUnitSize;
+	/*
+	 * The unit size is a power of two, so the compare-swap position is
+	 * computed by shift and mask only; the host passes log2 of the unit
+	 * size as-is, instead of expanding it to a value that would need
+	 * integer division here. The reversing flag is a literal constant
+	 * on both of the call sites below, so its selection folds away at
+	 * the compile time, not a branch per thread.
+	 */
+	idx0 = ((threadID >> (unitsz_log2 - 1)) << unitsz_log2 |
+			(threadID & (halfUnitSize - 1)));
 	idx1 = (reversing
 			? ((idx0 & ~unitMask) | (~idx0 & unitMask))
 			: (idx0 + halfUnitSize));
 	if(nrows <= idx1)
 		return;
 
+	/*
+	 * On the last sub-stage (unitsz == 2), idx0 is even and idx1 is
+	 * always its neighbour, for both of the reversing and ordered
+	 * cases. So, the pair can be moved by a single int2 load/store,
+	 * which halves the number of memory transactions on results[].
+	 */
+	if (halfUnitSize == 1)
+	{
+		int2	pair = vload2(idx0 >> 1, results);
+		int2	temp;
+		cl_int	rv;
+		cl_int	swap_mask;
+
+		rv = gpusort_comp(errcode,
+						  kchunk, ktoast, pair.x,
+						  kchunk, ktoast, pair.y);
+		swap_mask = -(cl_int)(0 < rv);
+		temp.x = select(pair.x, pair.y, swap_mask);
+		temp.y = select(pair.y, pair.x, swap_mask);
+		vstore2(temp, idx0 >> 1, results);
+		return;
+	}
+
 	cl_int	pos0			= results[idx0];
 	cl_int	pos1			= results[idx1];
 	cl_int	rv;
+	cl_int	swap_mask;
 
+	/*
+	 * Branchless swap; a data-dependent branch here diverges the
+	 * wavefront on every comparison, so we store both slots
+	 * unconditionally through select() instead.
+	 */
 	rv = gpusort_comp(errcode, kchunk, ktoast, pos0, kchunk, ktoast, pos1);
-	if(0 < rv)
-	{
-		/* Swap */
-		results[idx0] = pos1;
-		results[idx1] = pos0;
-	}
+	swap_mask = -(cl_int)(0 < rv);
+	results[idx0] = select(pos0, pos1, swap_mask);
+	results[idx1] = select(pos1, pos0, swap_mask);
 	return;
 }
 
 /* expected kernel prototypes */
 static void
 run_gpusort_single_marge(
-	__global kern_parambuf *kparams,
+	__constant kern_parambuf *kparams,
 	__global kern_column_store *kchunk,	/* in */
 	__global kern_toastbuf *ktoast,		/* in */
 	__private cl_int *errcode,			/* out */
 	__local int localIdx[] )
 {
-	__global cl_int	*results = KERN_GPUSORT_RESULT_INDEX(kchunk);
+	__global cl_int	*results = gpusort_result_index(kchunk);
 	cl_int			nrows	 = (kchunk)->nrows;
 
 	/*
@@ -273,11 +403,10 @@ run_gpusort_single_marge(
 									 kchunk, ktoast, pos0,
 									 kchunk, ktoast, pos1);
 
-			if(0 < rv) {
-				// swap
-				localIdx[idx0] = pos1;
-				localIdx[idx1] = pos0;
-			}
+			// branchless swap, see run_gpusort_single_step
+			cl_int swap_mask = -(cl_int)(0 < rv);
+			localIdx[idx0] = select(pos0, pos1, swap_mask);
+			localIdx[idx1] = select(pos1, pos0, swap_mask);
 		}
 		barrier(CLK_LOCAL_MEM_FENCE);
     }
@@ -296,13 +425,13 @@ run_gpusort_single_marge(
 /* expected kernel prototypes */
 static void
 run_gpusort_single_sort(
-	__global kern_parambuf *kparams,
+	__constant kern_parambuf *kparams,
 	__global kern_column_store *kchunk,	/* in */
 	__global kern_toastbuf *ktoast,		/* in */
 	__private cl_int *errcode,			/* out */
 	__local int localIdx[] )
 {
-	__global cl_int	*results = KERN_GPUSORT_RESULT_INDEX(kchunk);
+	__global cl_int	*results = gpusort_result_index(kchunk);
 	cl_int			nrows	 = (kchunk)->nrows;
 
 	/*
@@ -325,18 +454,40 @@ run_gpusort_single_sort(
 						   ? prtSize
 						   : (nrows - prtPos));
 
-    // load index to localIdx
-    if(localID < localEntry)
-		localIdx[localID] = results[prtPos + localID];
+	/*
+	 * Load the index to localIdx; the first compare-swap stage
+	 * (blockSize=2) is fused into the load. Each thread fetches one
+	 * adjacent pair, so both elements are still in registers when
+	 * they are compared, and the pre-swapped pair goes to the local
+	 * buffer directly - one whole pass over localIdx[] and its
+	 * barrier are saved. Note that prtPos and prtSize are always
+	 * even, so a pair never straddles partitions.
+	 */
+	{
+		cl_int	idx0 = 2 * localID;
+		cl_int	idx1 = idx0 + 1;
 
-    if(localSize + localID < localEntry)
-		localIdx[localSize + localID] = results[prtPos + localSize + localID];
+		if(idx1 < localEntry)
+		{
+			cl_int pos0 = results[prtPos + idx0];
+			cl_int pos1 = results[prtPos + idx1];
+			cl_int rv = gpusort_comp(errcode,
+									 kchunk, ktoast, pos0,
+									 kchunk, ktoast, pos1);
 
+			// branchless swap, see run_gpusort_single_step
+			cl_int swap_mask = -(cl_int)(0 < rv);
+			localIdx[idx0] = select(pos0, pos1, swap_mask);
+			localIdx[idx1] = select(pos1, pos0, swap_mask);
+		}
+		else if(idx0 < localEntry)
+			localIdx[idx0] = results[prtPos + idx0];
+	}
     barrier(CLK_LOCAL_MEM_FENCE);
 
 
-	// bitonic sort
-	for(int blockSize=2; blockSize<=prtSize; blockSize*=2)
+	// bitonic sort; the blockSize=2 stage was applied on the load above
+	for(int blockSize=4; blockSize<=prtSize; blockSize*=2)
 	{
 		int blockMask		= blockSize - 1;
 		int halfBlockSize	= blockSize / 2;
@@ -362,11 +513,10 @@ run_gpusort_single_sort(
 										 kchunk, ktoast, pos0,
 										 kchunk, ktoast, pos1);
 
-				if(0 < rv) {
-					// swap
-					localIdx[idx0] = pos1;
-					localIdx[idx1] = pos0;
-				}
+				// branchless swap, see run_gpusort_single_step
+				cl_int swap_mask = -(cl_int)(0 < rv);
+				localIdx[idx0] = select(pos0, pos1, swap_mask);
+				localIdx[idx1] = select(pos1, pos0, swap_mask);
 			}
 			barrier(CLK_LOCAL_MEM_FENCE);
 		}
@@ -383,200 +533,106 @@ run_gpusort_single_sort(
 	return;
 }
 
-#if 0
+/*
+ * gpusort_column_to_column_coop
+ *
+ * A workgroup-cooperative variant of kern_column_to_column, for
+ * column-stores that share an identical layout (the sorting chunks of
+ * one query do). kern_column_to_column lets every thread walk over all
+ * the columns of its own row one by one, so neighbour lanes touch
+ * cachelines far apart from each other. Here the whole workgroup moves
+ * its tile of rows together; the (column, row) pairs are spread over
+ * the lanes row-major within a column, so adjacent lanes read and
+ * write adjacent items of the same value array and the memory
+ * transactions coalesce in the row direction.
+ *
+ * The caller puts the per-thread source and destination row indexes on
+ * l_src_index[] / l_dst_index[] (local arrays of the workgroup size,
+ * ordered by local id), then calls here with number of valid entries;
+ * a negative source index means the row has no source and is skipped.
+ *
+ * Only the fixed-width portion of each column is moved; for variable-
+ * width columns this is the per-row offset (cl_uint) into the toast
+ * buffer, so the caller has to keep the toast payload reachable from
+ * the destination store (the merge path rearranges rows but leaves the
+ * payloads in place). The gather pattern makes the row mapping non-
+ * contiguous, so async_work_group_copy is of no use here.
+ */
 static void
-gpusort_set_record(__global kern_parambuf		*kparams,
-				   cl_int			 			index,
-				   cl_int						N,
-				   cl_int						nrowsDst0,
-				   __global kern_column_store	*chunkDst0,
-				   __global kern_toastbuf		*toastDst0,
-				   __global kern_column_store	*chunkDst1,
-				   __global kern_toastbuf		*toastDst1,
-				   __global kern_column_store	*chunkSrc0,
-				   __global kern_toastbuf		*toastSrc0,
-				   __global kern_column_store	*chunkSrc1,
-				   __global kern_toastbuf		*toastSrc1,
-				   __global cl_int				*result0,
-				   __global cl_int				*result1,
-				   __private cl_int				*errcode,
-				   __local void				 	*local_workbuf)
+gpusort_column_to_column_coop(cl_uint ncols,
+							  __global kern_column_store *kcs_dst,
+							  __global kern_column_store *kcs_src,
+							  __local cl_int *l_dst_index,
+							  __local cl_int *l_src_index,
+							  cl_uint nitems)
 {
-	cl_int N2			= N / 2;
-	cl_int posDst		= index;
-	cl_int posSrc 		= (index < N2) ? result0[index] : result1[index - N2];
-	cl_int chunkPosDst	= (posDst < nrowsDst0) ? posDst : posDst - nrowsDst0;
-	cl_int chunkPosSrc	= (posSrc < N2) ? posSrc : posSrc - N2;
+	cl_uint		lsz = get_local_size(0);
+	cl_uint		lid = get_local_id(0);
+	cl_uint		nrooms_dst = kcs_dst->nrooms;
+	cl_uint		nrooms_src = kcs_src->nrooms;
+	cl_uint		unit;
 
-	__global kern_column_store *chunkDst;
-	__global kern_column_store *chunkSrc;
-	__global kern_toastbuf     *toastDst;
-	__global kern_toastbuf     *toastSrc;
-
-	chunkDst = (posDst < nrowsDst0) ? chunkDst0 : chunkDst1;
-	toastDst = (posDst < nrowsDst0) ? toastDst0 : toastDst1;
-	chunkSrc = (posSrc < N2) ? chunkSrc0 : chunkSrc1;
-	toastSrc = (posSrc < N2) ? toastSrc0 : toastSrc1;
-
-
-	// set nrows
-	if(chunkPosDst == N2 - 1  &&  posSrc < N)
-		(chunkDst)->nrows = N2;
+	/* visibility of the index arrays put by the caller */
+	barrier(CLK_LOCAL_MEM_FENCE);
 
-	else if(N <= posSrc)
+	for (unit = lid; unit < ncols * nitems; unit += lsz)
 	{
-		cl_int flagLastPlus1 = true;
+		cl_uint		icol = unit / nitems;
+		cl_uint		irow = unit % nitems;
+		cl_int		dst_index = l_dst_index[irow];
+		cl_int		src_index = l_src_index[irow];
+		kern_colmeta cmeta = kcs_dst->colmeta[icol];
+		cl_uint		attlen = (cmeta.attlen > 0
+							  ? cmeta.attlen
+							  : sizeof(cl_uint));
+		__global cl_char *dst_base = ((__global cl_char *)kcs_dst +
+									  cmeta.cs_ofs);
+		__global cl_char *src_base = ((__global cl_char *)kcs_src +
+									  kcs_src->colmeta[icol].cs_ofs);
+
+		if (src_index < 0)
+			continue;
 
-		if(0 < chunkPosDst)
+		if (!cmeta.attnotnull)
 		{
-			cl_int indexPrev = index - 1;
-			cl_int posPrev	 = ((indexPrev < N2)
-								? result0[indexPrev]
-								: result1[indexPrev - N2]);
-			if(N <= posPrev)
-			  flagLastPlus1 = false;
+			/*
+			 * nullmap is located on the head of the value array; the
+			 * lanes of a workgroup may share the same destination word,
+			 * so the bit has to be put with atomic operations.
+			 */
+			__global cl_uchar  *src_map = (__global cl_uchar *)src_base;
+			__global cl_uint   *dst_map = (__global cl_uint *)dst_base;
+
+			if ((src_map[src_index >> 3] >> (src_index & 7)) & 1)
+				atomic_or(&dst_map[dst_index >> 5],
+						  1U << (dst_index & 31));
+			else
+				atomic_and(&dst_map[dst_index >> 5],
+						   ~(1U << (dst_index & 31)));
+
+			src_base += STROMALIGN((nrooms_src + 7) / 8);
+			dst_base += STROMALIGN((nrooms_dst + 7) / 8);
 		}
 
-		if(flagLastPlus1 == true)
-			(chunkDst)->nrows = chunkPosDst;
-	}
-
-
-	// set index
-	__global cl_int *resultDst = KERN_GPUSORT_RESULT_INDEX(chunkDst);
-	resultDst[chunkPosDst]     = (posSrc < N) ? chunkPosDst : N;
-
-
-	// set row data
-	if(posSrc  < N)
-	{
-		kern_column_to_column(errcode,
-							  chunkDst, toastDst, chunkPosDst,
-							  chunkSrc, toastSrc, chunkPosSrc, local_workbuf);
-	}
-
-	return;
-}
-
-static void
-run_gpusort_multi(__global kern_parambuf *kparams,
-				  cl_bool reversing,		/* in */
-				  cl_uint unitsz,			/* out */
-				  __global kern_column_store *x_chunk,
-				  __global kern_toastbuf     *x_toast,
-				  __global kern_column_store *y_chunk,
-				  __global kern_toastbuf     *y_toast,
-				  __global kern_column_store *z_chunk0,
-				  __global kern_toastbuf     *z_toast0,
-				  __global kern_column_store *z_chunk1,
-				  __global kern_toastbuf     *z_toast1,
-				  __private cl_int *errcode,
-				  __local void *local_workbuf)
-{
-	__global cl_int	*x_results = KERN_GPUSORT_RESULT_INDEX(x_chunk);
-	__global cl_int	*y_results = KERN_GPUSORT_RESULT_INDEX(y_chunk);
-
-	/*
-	 * Run merge sort logic on the supplied x_chunk and y_chunk.
-	 * Its results shall be stored into z_chunk0 and z_chunk1,
-	 *
-	 */
-
-	cl_int	threadID		= get_global_id(0);
-	cl_int  x_nrows			= (x_chunk)->nrows;
-	cl_int	y_nrows			= (y_chunk)->nrows;
-	cl_int	halfUnitSize	= unitsz / 2;
-	cl_int	unitMask		= unitsz - 1;
-	cl_int	idx0;
-	cl_int	idx1;
-
-	idx0 = (threadID / halfUnitSize) * unitsz + threadID % halfUnitSize;
-	idx1 = (reversing
-			? ((idx0 & ~unitMask) | (~idx0 & unitMask))
-			: (idx0 + halfUnitSize));
-
-	cl_int	N;
-
-	for(int i=1; i<x_nrows+y_nrows; i<<=1) {
-	}
-
-	cl_int	N2	= N / 2; /* Starting index number of y_chunk */
-	if(N2 <= threadID)
-		return;
-
-	/* Re-numbering the index at first times. */
-	if(reversing)
-	{
-		if(x_nrows <= threadID)
-			x_results[threadID] = N;
-
-		y_results[idx1 - N2] = ((idx1 - N2 < y_nrows)
-								? (y_results[idx1 - N2] + N2)
-								: N);
-	}
-
-
-	__global cl_int	*result0;
-	__global cl_int	*result1;
-
-	result0 = (idx0 < N2) ? &x_results[idx0] : &y_results[idx0 - N2];
-	result1 = (idx1 < N2) ? &x_results[idx1] : &y_results[idx1 - N2];
-
-	cl_int	pos0	= *result0;
-	cl_int	pos1	= *result1;
-
-	if(N <= pos1)
-	{
-		/* pos1 is empry(maximum) */
-	}
-
-	else if (N <= pos0)
-	{
-		/* swap, pos0 is empry(maximum) */
-		*result0 = pos1;
-		*result1 = pos0;
-	}
-
-	else
-	{
-		/* sorting by data */
-		__global kern_column_store	*chunk0 = (pos0 < N2) ? x_chunk : y_chunk;
-		__global kern_column_store	*chunk1 = (pos1 < N2) ? x_chunk : y_chunk;
-		__global kern_toastbuf		*toast0 = (pos0 < N2) ? x_toast : y_toast;
-		__global kern_toastbuf		*toast1 = (pos1 < N2) ? x_toast : y_toast;
-		cl_int						chkPos0 = (pos0 < N2) ? pos0 : (pos0 - N2);
-		cl_int						chkPos1 = (pos1 < N2) ? pos1 : (pos1 - N2);
-
-		cl_int rv = gpusort_comp(errcode,
-								 chunk0, toast0, chkPos0,
-								 chunk1, toast1, chkPos1);
-		if(0 < rv)
+		if (attlen == sizeof(cl_ushort))
+			((__global cl_ushort *)dst_base)[dst_index]
+				= ((__global cl_ushort *)src_base)[src_index];
+		else if (attlen == sizeof(cl_uint))
+			((__global cl_uint *)dst_base)[dst_index]
+				= ((__global cl_uint *)src_base)[src_index];
+		else if (attlen == sizeof(cl_ulong))
+			((__global cl_ulong *)dst_base)[dst_index]
+				= ((__global cl_ulong *)src_base)[src_index];
+		else
 		{
-			/* swap */
-			*result0 = pos1;
-			*result1 = pos0;
-		}
-	}
+			cl_uint		k;
 
-	/* Update output chunk at last kernel. */
-	if(unitsz == 2)
-	{
-		gpusort_set_record(kparams, idx0, N, N2,
-						   z_chunk0, z_toast0, z_chunk1, z_toast1,
-						   x_chunk, x_toast, y_chunk, y_toast,
-						   x_results, y_results,
-						   errcode, local_workbuf);
-
-		gpusort_set_record(kparams, idx1, N, N2,
-						   z_chunk0, z_toast0, z_chunk1, z_toast1,
-						   x_chunk, x_toast, y_chunk, y_toast,
-						   x_results, y_results,
-						   errcode, local_workbuf);
+			for (k = 0; k < attlen; k++)
+				dst_base[dst_index * attlen + k]
+					= src_base[src_index * attlen + k];
+		}
 	}
-
-	return;
 }
-#endif
 
 /*
  * gpusort_single
@@ -584,39 +640,66 @@ run_gpusort_multi(__global kern_parambuf *kparams,
  * Entrypoint of the kernel function for single chunk sorting. It takes
  * a gpusort-chunk, to be sorted according to gpusort_comp() being
  * generated on the fly.
+ *
+ * The kernels below take their workgroup size from the runtime (see
+ * clserv_compute_workgroup_size), so reqd_work_group_size cannot be
+ * declared on them; work_group_size_hint tells the compiler the usual
+ * shape instead, that allows it to provision registers for the common
+ * case without rejecting a smaller size on limited devices.
+ */
+__kernel void
+__attribute__((work_group_size_hint(GPUSORT_LOCAL_WORKSZ,1,1)))
+gpusort_single_step_fwd(
+	cl_uint unitsz_log2,
+	__constant kern_parambuf *kparams,
+	__global kern_gpusort *kgsort,
+	__local void *local_workbuf)
+{
+	__global kern_column_store *kchunk	= KERN_GPUSORT_CHUNK(kgsort);
+	__global kern_toastbuf *ktoast		= KERN_GPUSORT_TOASTBUF(kgsort);
+	__global cl_int		   *kstatus		= KERN_GPUSORT_STATUS(kgsort);
+	cl_int		errcode = StromError_Success;
+
+	run_gpusort_single_step(kparams, false, unitsz_log2, kchunk, ktoast,
+							&errcode);
+	kern_writeback_error_status(kstatus, errcode, local_workbuf);
+}
+
+/*
+ * The direction of a sub-stage never changes within one invocation, so
+ * it is specialized into the two entrypoints above/below rather than
+ * decoded from the sign of the kernel argument every launch; the host
+ * picks the proper one per (block, unit) pair.
  */
 __kernel void
-gpusort_single_step(
-	cl_int bitonic_unitsz,
+__attribute__((work_group_size_hint(GPUSORT_LOCAL_WORKSZ,1,1)))
+gpusort_single_step_rev(
+	cl_uint unitsz_log2,
+	__constant kern_parambuf *kparams,
 	__global kern_gpusort *kgsort,
 	__local void *local_workbuf)
 {
-	__global kern_parambuf *kparams		= KERN_GPUSORT_PARAMBUF(kgsort);
 	__global kern_column_store *kchunk	= KERN_GPUSORT_CHUNK(kgsort);
 	__global kern_toastbuf *ktoast		= KERN_GPUSORT_TOASTBUF(kgsort);
 	__global cl_int		   *kstatus		= KERN_GPUSORT_STATUS(kgsort);
-	__global cl_int		   *results		= KERN_GPUSORT_RESULT_INDEX(kchunk);
-	cl_bool		reversing = (bitonic_unitsz < 0 ? true : false);
-	cl_uint		unitsz = (bitonic_unitsz < 0
-						  ? 1U << -bitonic_unitsz
-						  : 1U << bitonic_unitsz);
 	cl_int		errcode = StromError_Success;
 
-	run_gpusort_single_step(kparams, reversing, unitsz, kchunk, ktoast,
+	run_gpusort_single_step(kparams, true, unitsz_log2, kchunk, ktoast,
 							&errcode);
 	kern_writeback_error_status(kstatus, errcode, local_workbuf);
 }
 
 __kernel void
+__attribute__((work_group_size_hint(GPUSORT_LOCAL_WORKSZ,1,1)))
 gpusort_single_marge(
+	__constant kern_parambuf *kparams,
 	__global kern_gpusort *kgsort,
 	__local void *local_workbuf)
 {
-	__global kern_parambuf *kparams		= KERN_GPUSORT_PARAMBUF(kgsort);
 	__global kern_column_store *kchunk	= KERN_GPUSORT_CHUNK(kgsort);
 	__global kern_toastbuf *ktoast		= KERN_GPUSORT_TOASTBUF(kgsort);
 	__global cl_int		   *kstatus		= KERN_GPUSORT_STATUS(kgsort);
-	__global cl_int		   *results		= KERN_GPUSORT_RESULT_INDEX(kchunk);
+	__global cl_int		   *results		= gpusort_result_index(kchunk);
 	cl_int errcode = StromError_Success;
 
 	run_gpusort_single_marge(kparams, kchunk, ktoast, &errcode, local_workbuf);
@@ -624,15 +707,16 @@ gpusort_single_marge(
 }
 
 __kernel void
+__attribute__((work_group_size_hint(GPUSORT_LOCAL_WORKSZ,1,1)))
 gpusort_single_sort(
+	__constant kern_parambuf *kparams,
 	__global kern_gpusort *kgsort,
 	__local void *local_workbuf)
 {
-	__global kern_parambuf *kparams		= KERN_GPUSORT_PARAMBUF(kgsort);
 	__global kern_column_store *kchunk	= KERN_GPUSORT_CHUNK(kgsort);
 	__global kern_toastbuf *ktoast		= KERN_GPUSORT_TOASTBUF(kgsort);
 	__global cl_int		   *kstatus		= KERN_GPUSORT_STATUS(kgsort);
-	__global cl_int		   *results		= KERN_GPUSORT_RESULT_INDEX(kchunk);
+	__global cl_int		   *results		= gpusort_result_index(kchunk);
 	cl_int errcode = StromError_Success;
 
 	run_gpusort_single_sort(kparams, kchunk, ktoast, &errcode, local_workbuf);
@@ -640,48 +724,647 @@ gpusort_single_sort(
 }
 
 /*
- * gpusort_multi
+ * gpusort_single_local
+ *
+ * A variation of gpusort_single_marge with compile-time workgroup size.
+ * Each workgroup loads a tile of 2 * GPUSORT_LOCAL_WORKSZ result indexes
+ * onto a statically allocated local array, then runs all the remaining
+ * bitonic sub-stages on the tile with local barriers only; one kernel
+ * invocation replaces log2(2 * GPUSORT_LOCAL_WORKSZ) individual step
+ * invocations that would have read and written results[] on global
+ * memory every time.
+ * The reqd_work_group_size declaration allows the compiler to provision
+ * registers and local memory tightly for the fixed workgroup shape.
+ */
+__kernel void
+__attribute__((reqd_work_group_size(GPUSORT_LOCAL_WORKSZ,1,1)))
+gpusort_single_local(__constant kern_parambuf *kparams,
+					 __global kern_gpusort *kgsort)
+{
+	__global kern_column_store *kchunk	= KERN_GPUSORT_CHUNK(kgsort);
+	__global kern_toastbuf *ktoast		= KERN_GPUSORT_TOASTBUF(kgsort);
+	__global cl_int		   *kstatus		= KERN_GPUSORT_STATUS(kgsort);
+	__local cl_int			localIdx[2 * GPUSORT_LOCAL_WORKSZ];
+	cl_int errcode = StromError_Success;
+
+	run_gpusort_single_marge(kparams, kchunk, ktoast, &errcode, localIdx);
+	kern_writeback_error_status(kstatus, errcode, localIdx);
+}
+
+/*
+ * gpusort_grid_barrier
+ *
+ * Inter-workgroup synchronization used by gpusort_single_persistent.
+ * The counter monotonically increases; the n-th barrier waits until it
+ * reaches n * (number of workgroups), so no reset of the counter (and
+ * no race around it) is needed between the barriers. Note that it is
+ * safe only when every workgroup of the grid is resident on the device
+ * simultaneously; the caller launches one workgroup per compute unit
+ * to keep this assumption.
+ */
+static void
+gpusort_grid_barrier(volatile __global cl_uint *sync_count, cl_uint target)
+{
+	barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+	if (get_local_id(0) == 0)
+	{
+		atomic_inc((__global cl_uint *)sync_count);
+		while (atomic_add((__global cl_uint *)sync_count, 0) < target)
+			;	/* spin until the last workgroup arrives */
+	}
+	barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+}
+
+/*
+ * gpusort_single_persistent
+ *
+ * An alternative of the host-driven bitonic network; one kernel
+ * invocation loops over all the (blocksz, unitsz) sub-stages and
+ * synchronizes the whole grid with gpusort_grid_barrier between them,
+ * instead of O(log^2 N) individual kernel launches whose per-launch
+ * overhead never overlaps with the sorting itself. The grid is sized
+ * to the device, not to the chunk, so each thread walks on the
+ * compare-swap positions with a grid-stride loop.
+ */
+__kernel void
+__attribute__((reqd_work_group_size(GPUSORT_LOCAL_WORKSZ,1,1)))
+gpusort_single_persistent(__constant kern_parambuf *kparams,
+						  __global kern_gpusort *kgsort,
+						  volatile __global cl_uint *sync_count,
+						  __local void *local_workbuf)
+{
+	__global kern_column_store *kchunk	= KERN_GPUSORT_CHUNK(kgsort);
+	__global kern_toastbuf *ktoast		= KERN_GPUSORT_TOASTBUF(kgsort);
+	__global cl_int		   *kstatus		= KERN_GPUSORT_STATUS(kgsort);
+	__global cl_int		   *results		= gpusort_result_index(kchunk);
+	cl_int		errcode = StromError_Success;
+	cl_uint		nrows = kchunk->nrows;
+	cl_uint		N = 1 << (32 - clz(nrows - 1));
+	cl_uint		nbarriers = 0;
+	cl_uint		blocksz;
+	cl_uint		unitsz;
+
+	for (blocksz = 2; blocksz <= N; blocksz <<= 1)
+	{
+		for (unitsz = blocksz; unitsz >= 2; unitsz >>= 1)
+		{
+			cl_bool		reversing = (unitsz == blocksz);
+			cl_uint		unitMask = unitsz - 1;
+			cl_uint		halfUnitSize = unitsz >> 1;
+			cl_uint		tid;
+
+			for (tid = get_global_id(0); tid < N / 2;
+				 tid += get_global_size(0))
+			{
+				cl_uint	idx0 = ((tid / halfUnitSize) * unitsz +
+								(tid % halfUnitSize));
+				cl_uint	idx1 = (reversing
+								? ((idx0 & ~unitMask) | (~idx0 & unitMask))
+								: (idx0 + halfUnitSize));
+
+				if (idx1 < nrows)
+				{
+					cl_int	pos0 = results[idx0];
+					cl_int	pos1 = results[idx1];
+					cl_int	rv = gpusort_comp(&errcode,
+											  kchunk, ktoast, pos0,
+											  kchunk, ktoast, pos1);
+
+					// branchless swap, see run_gpusort_single_step
+					cl_int	swap_mask = -(cl_int)(0 < rv);
+					results[idx0] = select(pos0, pos1, swap_mask);
+					results[idx1] = select(pos1, pos0, swap_mask);
+				}
+			}
+			nbarriers++;
+			gpusort_grid_barrier(sync_count,
+								 nbarriers * get_num_groups(0));
+		}
+	}
+	kern_writeback_error_status(kstatus, errcode, local_workbuf);
+}
+
+/*
+ * gpusort_radix_hist
+ *
+ * First phase of a radix pass; each workgroup counts the digit
+ * distribution of its own partition on local memory counters, then
+ * writes them back digit-major (pass_hist[digit][group]), so the
+ * scan phase can compute scatter offsets that keep the ordering
+ * between the partitions.
+ */
+__kernel void
+__attribute__((reqd_work_group_size(GPUSORT_RADIX_WORKSZ,1,1)))
+gpusort_radix_hist(cl_int digit_shift,
+				   cl_int src_is_alt,
+				   __global kern_gpusort *kgsort,
+				   __global cl_int *rindex_alt,
+				   __global cl_uint *pass_hist)
+{
+	__global kern_column_store *kchunk = KERN_GPUSORT_CHUNK(kgsort);
+	__global cl_ulong *keys = gpusort_keys(kchunk);
+	__global cl_int *rindex = (src_is_alt
+							   ? rindex_alt
+							   : gpusort_result_index(kchunk));
+	__local cl_uint	l_count[GPUSORT_RADIX_SLOTS];
+	cl_uint		nrows = kchunk->nrows;
+	cl_uint		lid = get_local_id(0);
+	cl_uint		gid = get_global_id(0);
+
+	l_count[lid] = 0;
+	barrier(CLK_LOCAL_MEM_FENCE);
+	if (gid < nrows)
+	{
+		cl_uint	digit = ((keys[rindex[gid]] >> digit_shift) &
+						 (GPUSORT_RADIX_SLOTS - 1));
+		atomic_inc(&l_count[digit]);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+	pass_hist[lid * get_num_groups(0) + get_group_id(0)] = l_count[lid];
+}
+
+/*
+ * gpusort_radix_scan
  *
- * Entrypoint of the kernel function for multi chunks sorting. It takes
- * two input chunks and two output chunks. Records in the both input
- * chunks are sorted according to gpusort_comp() being generated on the
- * fly, then written to the output chunks; smaller half shall be kgsort_z1,
- * larger half shall be kgsort_z2.
+ * Second phase of a radix pass; a single workgroup rewrites the
+ * per-partition digit counters into exclusive scatter offsets.
+ * Each thread owns one digit; it sums up the counters of all the
+ * partitions, joins the local prefix-sum to get the base offset of
+ * its digit, then distributes running offsets back to pass_hist.
  */
 __kernel void
-gpusort_multi(cl_int mergesort_unitsz,
-			  __global kern_gpusort *kgsort_x,
-			  __global kern_gpusort *kgsort_y,
-			  __global kern_gpusort *kgsort_z1,
-			  __global kern_gpusort *kgsort_z2,
-			  __local void *local_workbuf)
+__attribute__((reqd_work_group_size(GPUSORT_RADIX_WORKSZ,1,1)))
+gpusort_radix_scan(cl_uint num_parts,
+				   __global cl_uint *pass_hist)
+{
+	__local cl_uint	l_sum[GPUSORT_RADIX_SLOTS];
+	cl_uint		lid = get_local_id(0);
+	cl_uint		total = 0;
+	cl_uint		temp;
+	cl_uint		i;
+
+	for (i=0; i < num_parts; i++)
+		total += pass_hist[lid * num_parts + i];
+	l_sum[lid] = total;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	/* inclusive prefix-sum of the per-digit totals */
+	for (i=1; i < GPUSORT_RADIX_SLOTS; i <<= 1)
+	{
+		temp = (lid >= i) ? l_sum[lid - i] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		l_sum[lid] += temp;
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	/* then, exclusive base offset of this digit */
+	total = l_sum[lid] - total;
+
+	for (i=0; i < num_parts; i++)
+	{
+		temp = pass_hist[lid * num_parts + i];
+		pass_hist[lid * num_parts + i] = total;
+		total += temp;
+	}
+}
+
+/*
+ * gpusort_radix_reorder
+ *
+ * Last phase of a radix pass; it scatters the result indexes to the
+ * positions computed by the scan phase. Stability between the passes
+ * requires items with the same digit to keep their source ordering,
+ * so the rank within a workgroup is counted from the preceding local
+ * items instead of atomic counters whose ordering is arbitrary.
+ */
+__kernel void
+__attribute__((reqd_work_group_size(GPUSORT_RADIX_WORKSZ,1,1)))
+gpusort_radix_reorder(cl_int digit_shift,
+					  cl_int src_is_alt,
+					  __global kern_gpusort *kgsort,
+					  __global cl_int *rindex_alt,
+					  __global cl_uint *pass_hist)
+{
+	__global kern_column_store *kchunk = KERN_GPUSORT_CHUNK(kgsort);
+	__global cl_ulong *keys = gpusort_keys(kchunk);
+	__global cl_int *rindex_chunk = gpusort_result_index(kchunk);
+	__global cl_int *rindex_src = (src_is_alt ? rindex_alt : rindex_chunk);
+	__global cl_int *rindex_dst = (src_is_alt ? rindex_chunk : rindex_alt);
+	__local cl_ushort l_digit[GPUSORT_RADIX_WORKSZ];
+	cl_uint		nrows = kchunk->nrows;
+	cl_uint		lid = get_local_id(0);
+	cl_uint		gid = get_global_id(0);
+	cl_uint		digit = GPUSORT_RADIX_SLOTS;	/* an invalid digit */
+	cl_uint		rank = 0;
+	cl_int		pos = 0;
+	cl_uint		i;
+
+	if (gid < nrows)
+	{
+		pos = rindex_src[gid];
+		digit = (keys[pos] >> digit_shift) & (GPUSORT_RADIX_SLOTS - 1);
+	}
+	l_digit[lid] = digit;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (gid < nrows)
+	{
+		for (i=0; i < lid; i++)
+		{
+			if (l_digit[i] == digit)
+				rank++;
+		}
+		rindex_dst[pass_hist[digit * get_num_groups(0) +
+							 get_group_id(0)] + rank] = pos;
+	}
+}
+
+/*
+ * gpusort_multi_partition
+ *
+ * The first half of the inter-chunk merge. The merged output of the two
+ * sorted chunks is cut into tiles of GPUSORT_MERGE_TILESZ rows; one
+ * thread per tile boundary finds how many rows the x_chunk contributes
+ * to the output in front of the boundary (the co-rank) by binary search
+ * on the merge diagonal, and puts it on part_pos[]. The y_chunk
+ * contribution needs no storage; it is the diagonal minus the x one.
+ * Two neighbouring entries of part_pos[] thus describe a pair of source
+ * ranges that gpusort_multi_merge can turn into one output tile without
+ * looking at any other tile.
+ *
+ * The caller launches at least (number of tiles + 1) threads; part_pos[]
+ * takes one entry per tile boundary, both ends inclusive.
+ */
+__kernel void
+__attribute__((work_group_size_hint(GPUSORT_LOCAL_WORKSZ,1,1)))
+gpusort_multi_partition(__global kern_gpusort *kgsort_x,
+						__global kern_gpusort *kgsort_y,
+						__global cl_uint *part_pos,
+						__local void *local_workbuf)
+{
+	__global kern_column_store *x_chunk = KERN_GPUSORT_CHUNK(kgsort_x);
+	__global kern_column_store *y_chunk = KERN_GPUSORT_CHUNK(kgsort_y);
+	__global kern_toastbuf *x_toast = KERN_GPUSORT_TOASTBUF(kgsort_x);
+	__global kern_toastbuf *y_toast = KERN_GPUSORT_TOASTBUF(kgsort_y);
+	__global cl_int	   *kstatus = KERN_GPUSORT_STATUS(kgsort_x);
+	__global cl_int	   *x_results = gpusort_result_index(x_chunk);
+	__global cl_int	   *y_results = gpusort_result_index(y_chunk);
+	cl_int		x_nrows = x_chunk->nrows;
+	cl_int		y_nrows = y_chunk->nrows;
+	cl_int		total = x_nrows + y_nrows;
+	cl_int		n_tiles = ((total + GPUSORT_MERGE_TILESZ - 1)
+						   / GPUSORT_MERGE_TILESZ);
+	cl_int		errcode = StromError_Success;
+
+	if (get_global_id(0) <= n_tiles)
+	{
+		cl_int	d = min((cl_int)get_global_id(0) * GPUSORT_MERGE_TILESZ,
+						total);
+		cl_int	lo = (d > y_nrows ? d - y_nrows : 0);
+		cl_int	hi = (d < x_nrows ? d : x_nrows);
+
+		/*
+		 * Find the largest i such that taking i rows from the x_chunk
+		 * and d-i rows from the y_chunk is a consistent cut of the
+		 * first d output rows. Rows of the x_chunk win the ties, so
+		 * the merge is stable with the x side in front.
+		 */
+		while (lo < hi)
+		{
+			cl_int	i = (lo + hi) / 2;		/* lo <= i < hi */
+
+			if (gpusort_comp(&errcode,
+							 x_chunk, x_toast, x_results[i],
+							 y_chunk, y_toast, y_results[d - i - 1]) <= 0)
+				lo = i + 1;
+			else
+				hi = i;
+		}
+		part_pos[get_global_id(0)] = lo;
+	}
+	kern_writeback_error_status(kstatus, errcode, local_workbuf);
+}
+
+/*
+ * gpusort_merge_comp
+ *
+ * Comparator of the per-tile merge; the caller stages the encoded sort
+ * keys of its tile onto l_keys[] (the x-origin part on the head, like
+ * the staged result indexes), so nearly all the decisions are made on a
+ * 64bit compare of two local memory slots. Only a tie of the encoded
+ * keys has to fall back to gpusort_comp() that walks the column-store
+ * on global memory; if the key encoder is the degenerate one, every
+ * pair ties and the behavior is the generic comparator as before.
+ */
+static cl_int
+gpusort_merge_comp(__private cl_int *errcode,
+				   __global kern_column_store *x_chunk,
+				   __global kern_toastbuf *x_toast,
+				   __global kern_column_store *y_chunk,
+				   __global kern_toastbuf *y_toast,
+				   __local cl_ulong *l_keys,
+				   __local cl_int *l_spos,
+				   cl_int nx,
+				   cl_int xi,		/* index on the x-origin part */
+				   cl_int yi)		/* index on the y-origin part */
+{
+	cl_ulong	kx = l_keys[xi];
+	cl_ulong	ky = l_keys[nx + yi];
+
+	if (kx != ky)
+		return (kx < ky ? -1 : 1);
+	return gpusort_comp(errcode,
+						x_chunk, x_toast, l_spos[xi],
+						y_chunk, y_toast, l_spos[nx + yi]);
+}
+
+/*
+ * gpusort_multi_merge
+ *
+ * The second half of the inter-chunk merge; the workgroup-id is the
+ * index of the output tile to be generated. The result indexes and the
+ * encoded sort keys of the source ranges located by
+ * gpusort_multi_partition are staged onto the
+ * local memory, then every thread produces GPUSORT_MERGE_TILESZ /
+ * GPUSORT_MERGE_WORKSZ output rows by a plain linear merge; a thread
+ * finds its own start position with the same co-rank search as the
+ * partition kernel, but on the staged arrays, so it is cheap. So, the
+ * whole merge takes O(x + y) comparisons, not O((x + y) log(x + y)) of
+ * the bitonic merging network this kernel replaced, and involves no
+ * power-of-two padding nor sentinel entries; kgsort_z1 receives fully
+ * sorted rows up to its nrooms, kgsort_z2 the remainings, both with
+ * the result index reset to the identity.
+ *
+ * The cooperative column copy moves the per-row toast offsets as-is,
+ * so the host has to stage the toast of both destination chunks as the
+ * payload of x_toast followed by the payload of y_toast (two DMA
+ * copies, nothing done by the kernel). Offsets of the x-origin rows
+ * are then valid on the destination as they are; the y-origin ones are
+ * rebased here by the payload length of x_toast.
+ */
+__kernel void
+__attribute__((reqd_work_group_size(GPUSORT_MERGE_WORKSZ,1,1)))
+gpusort_multi_merge(__global kern_gpusort *kgsort_x,
+					__global kern_gpusort *kgsort_y,
+					__global kern_gpusort *kgsort_z1,
+					__global kern_gpusort *kgsort_z2,
+					__global cl_uint *part_pos,
+					__local void *local_workbuf)
 {
-	__global kern_parambuf *kparams		= KERN_GPUSORT_PARAMBUF(kgsort_x);
 	__global kern_column_store *x_chunk = KERN_GPUSORT_CHUNK(kgsort_x);
 	__global kern_column_store *y_chunk = KERN_GPUSORT_CHUNK(kgsort_y);
 	__global kern_column_store *z_chunk1 = KERN_GPUSORT_CHUNK(kgsort_z1);
 	__global kern_column_store *z_chunk2 = KERN_GPUSORT_CHUNK(kgsort_z2);
 	__global kern_toastbuf *x_toast = KERN_GPUSORT_TOASTBUF(kgsort_x);
 	__global kern_toastbuf *y_toast = KERN_GPUSORT_TOASTBUF(kgsort_y);
-	__global kern_toastbuf *z_toast1 = KERN_GPUSORT_TOASTBUF(kgsort_z1);
-	__global kern_toastbuf *z_toast2 = KERN_GPUSORT_TOASTBUF(kgsort_z2);
-	__global cl_int		   *kstatus		= KERN_GPUSORT_STATUS(kgsort_x);
-	cl_bool		reversing = (mergesort_unitsz < 0 ? true : false);
-	cl_int		unitsz = (mergesort_unitsz < 0
-						  ? 1U << -mergesort_unitsz
-						  : 1U << mergesort_unitsz);
+	__global cl_int	   *kstatus = KERN_GPUSORT_STATUS(kgsort_x);
+	__global cl_int	   *x_results = gpusort_result_index(x_chunk);
+	__global cl_int	   *y_results = gpusort_result_index(y_chunk);
+	__global cl_ulong  *x_keys = gpusort_keys(x_chunk);
+	__global cl_ulong  *y_keys = gpusort_keys(y_chunk);
+	__local cl_int		l_spos[GPUSORT_MERGE_TILESZ];
+	__local cl_int		l_mpos[GPUSORT_MERGE_TILESZ];
+	__local cl_int		l_sidx[GPUSORT_MERGE_TILESZ];
+	__local cl_ulong	l_keys[GPUSORT_MERGE_TILESZ];
+	cl_int		x_nrows = x_chunk->nrows;
+	cl_int		y_nrows = y_chunk->nrows;
+	cl_int		total = x_nrows + y_nrows;
+	cl_int		boundary = z_chunk1->nrooms;
+	cl_int		lid = get_local_id(0);
+	cl_int		lsz = get_local_size(0);
+	cl_int		d0 = get_group_id(0) * GPUSORT_MERGE_TILESZ;
+	cl_int		d1 = min(d0 + GPUSORT_MERGE_TILESZ, total);
+	cl_int		xs;
+	cl_int		nx;
+	cl_int		ny;
+	cl_int		nitems = d1 - d0;
 	cl_int		errcode = StromError_Success;
+	cl_int		i, k;
 
-#if 0
-	run_gpusort_multi(kparams,
-					  reversing, unitsz,
-					  x_chunk, x_toast,
-					  y_chunk, y_toast,
-					  z_chunk1, z_toast1,
-					  z_chunk2, z_toast2,
-					  &errcode, local_workbuf);
+	/* an over-launched workgroup; nothing to do */
+	if (d0 >= total)
+		return;
+
+	xs = part_pos[get_group_id(0)];
+	nx = part_pos[get_group_id(0) + 1] - xs;
+	ny = nitems - nx;
+
+	/*
+	 * Stage the result indexes and the encoded sort keys of the source
+	 * ranges; the x-origin part on the head, the y-origin part just
+	 * after it. The comparator below then decides on the local keys and
+	 * touches the global column-store on a tie of them only.
+	 */
+	for (k = lid; k < nitems; k += lsz)
+	{
+		cl_int	pos = (k < nx
+					   ? x_results[xs + k]
+					   : y_results[(d0 - xs) + (k - nx)]);
+
+		l_spos[k] = pos;
+		l_keys[k] = (k < nx ? x_keys[pos] : y_keys[pos]);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	/* co-rank of this thread within the tile, then the linear merge */
+	{
+		cl_int	sd0 = min(lid * (GPUSORT_MERGE_TILESZ /
+								 GPUSORT_MERGE_WORKSZ), nitems);
+		cl_int	sd1 = min(sd0 + (GPUSORT_MERGE_TILESZ /
+								 GPUSORT_MERGE_WORKSZ), nitems);
+		cl_int	lo = (sd0 > ny ? sd0 - ny : 0);
+		cl_int	hi = (sd0 < nx ? sd0 : nx);
+		cl_int	li;
+		cl_int	lj;
+
+		while (lo < hi)
+		{
+			i = (lo + hi) / 2;
+
+			if (gpusort_merge_comp(&errcode,
+								   x_chunk, x_toast,
+								   y_chunk, y_toast,
+								   l_keys, l_spos, nx,
+								   i, sd0 - i - 1) <= 0)
+				lo = i + 1;
+			else
+				hi = i;
+		}
+		li = lo;
+		lj = sd0 - lo;
+
+		for (k = sd0; k < sd1; k++)
+		{
+			cl_bool	take_x;
+
+			if (lj >= ny)
+				take_x = true;
+			else if (li >= nx)
+				take_x = false;
+			else
+				take_x = (gpusort_merge_comp(&errcode,
+											 x_chunk, x_toast,
+											 y_chunk, y_toast,
+											 l_keys, l_spos, nx,
+											 li, lj) <= 0);
+			l_mpos[k] = (take_x
+						 ? l_spos[li++]
+						 : (GPUSORT_MERGE_YFLAG | l_spos[nx + lj++]));
+		}
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	/* result indexes of the destination chunks are the identity */
+	for (k = lid; k < nitems; k += lsz)
+	{
+		cl_int	pos = d0 + k;
+
+		if (pos < boundary)
+			gpusort_result_index(z_chunk1)[pos] = pos;
+		else
+			gpusort_result_index(z_chunk2)[pos - boundary] = pos - boundary;
+	}
+	if (get_global_id(0) == 0)
+	{
+		z_chunk1->nrows = min(total, boundary);
+		z_chunk2->nrows = max(total - boundary, 0);
+	}
+
+	/*
+	 * Move the row data, including the encoded keys and the global
+	 * row-id on the tail (so the comparator fast path keeps working on
+	 * the next merge), but not the result index being put above. Four
+	 * passes, one per (source, destination) combination; the rows of
+	 * the other combinations are marked by the negative source index.
+	 */
+	for (i = 0; i < 4; i++)
+	{
+		__global kern_column_store *kcs_src = ((i & 1) == 0
+											   ? x_chunk
+											   : y_chunk);
+		__global kern_column_store *kcs_dst = ((i & 2) == 0
+											   ? z_chunk1
+											   : z_chunk2);
+
+		for (k = lid; k < nitems; k += lsz)
+		{
+			cl_int	pos = d0 + k;
+			cl_int	from_y = ((l_mpos[k] & GPUSORT_MERGE_YFLAG) != 0);
+			cl_int	to_z2 = (pos >= boundary);
+
+			l_sidx[k] = (from_y == ((i & 1) != 0) &&
+						 to_z2 == ((i & 2) != 0)
+						 ? (l_mpos[k] & ~GPUSORT_MERGE_YFLAG)
+						 : -1);
+			l_spos[k] = (to_z2 ? pos - boundary : pos);
+		}
+		/* the barrier on the entry of the helper makes the arrays above
+		 * visible; the one below keeps the next pass from rewriting
+		 * them while a neighbour thread is still reading */
+		gpusort_column_to_column_coop(z_chunk1->ncols - 1,
+									  kcs_dst, kcs_src,
+									  l_spos, l_sidx, nitems);
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	/*
+	 * The y-origin rows still hold offsets of y_toast; rebase them
+	 * onto the concatenated layout described above. A null row may
+	 * hold trash on the offset slot, but trash plus delta is trash
+	 * as well and the null-bitmap keeps it invisible.
+	 */
+	barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+	{
+		cl_uint	toast_delta = (x_toast->usage -
+							   offsetof(kern_toastbuf, coldir[0]));
+
+		for (i = 0; i < z_chunk1->ncols - 3; i++)
+		{
+			if (z_chunk1->colmeta[i].attlen > 0)
+				continue;
+
+			for (k = lid; k < nitems; k += lsz)
+			{
+				__global kern_column_store *kcs_dst;
+				__global cl_char   *base;
+				cl_int		pos = d0 + k;
+				cl_int		cpos;
+
+				if ((l_mpos[k] & GPUSORT_MERGE_YFLAG) == 0)
+					continue;
+				kcs_dst = (pos < boundary ? z_chunk1 : z_chunk2);
+				cpos = (pos < boundary ? pos : pos - boundary);
+				base = ((__global cl_char *)kcs_dst +
+						kcs_dst->colmeta[i].cs_ofs);
+				if (!kcs_dst->colmeta[i].attnotnull)
+					base += STROMALIGN((kcs_dst->nrooms + 7) / 8);
+				((__global cl_uint *)base)[cpos] += toast_delta;
+			}
+		}
+	}
 	kern_writeback_error_status(kstatus, errcode, local_workbuf);
-#endif
+}
+
+/*
+ * gpusort_keyrange_update
+ *
+ * Reduction of the minimum/maximum encoded sort keys, maintained on the
+ * status block of the chunk (see KERN_GPUSORT_KEYRANGE). The setup
+ * kernels call here once the keys of their rows are materialized; the
+ * workgroup reduces on local memory first, so the global array takes
+ * one atom_min/atom_max pair per workgroup. The host then looks at the
+ * range to cut the radix passes whose key byte is proved constant.
+ *
+ * Stale partial results may be folded twice by the ceil-halving below
+ * when the workgroup size is not a power of two; min/max are
+ * idempotent, so it does not hurt.
+ *
+ * It relies on the 64bit atomics of cl_khr_int64_extended_atomics;
+ * on devices without the extension the range simply remains as the
+ * host initialized it (min > max, that is "unknown") and no pass is
+ * cut. All the threads of the workgroup have to call here;
+ * local_workmem takes sizeof(cl_ulong) per thread.
+ */
+static void
+gpusort_keyrange_update(__global kern_gpusort *kgpusort,
+						cl_ulong key,
+						cl_bool key_is_valid,
+						__local void *local_workmem)
+{
+#ifdef cl_khr_int64_extended_atomics
+	__global cl_ulong  *keyrange = KERN_GPUSORT_KEYRANGE(kgpusort);
+	__local cl_ulong   *l_keys = (__local cl_ulong *)local_workmem;
+	cl_uint		lsz = get_local_size(0);
+	cl_uint		lid = get_local_id(0);
+	cl_uint		i;
+
+	l_keys[lid] = (key_is_valid ? key : (cl_ulong)(-1));
+	barrier(CLK_LOCAL_MEM_FENCE);
+	for (i = (lsz + 1) / 2; ; i = (i + 1) / 2)
+	{
+		if (lid < i && lid + i < lsz)
+			l_keys[lid] = min(l_keys[lid], l_keys[lid + i]);
+		barrier(CLK_LOCAL_MEM_FENCE);
+		if (i == 1)
+			break;
+	}
+	if (lid == 0)
+		atom_min(&keyrange[0], l_keys[0]);
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	l_keys[lid] = (key_is_valid ? key : 0);
+	barrier(CLK_LOCAL_MEM_FENCE);
+	for (i = (lsz + 1) / 2; ; i = (i + 1) / 2)
+	{
+		if (lid < i && lid + i < lsz)
+			l_keys[lid] = max(l_keys[lid], l_keys[lid + i]);
+		barrier(CLK_LOCAL_MEM_FENCE);
+		if (i == 1)
+			break;
+	}
+	if (lid == 0)
+		atom_max(&keyrange[1], l_keys[0]);
+	barrier(CLK_LOCAL_MEM_FENCE);
+#endif	/* cl_khr_int64_extended_atomics */
 }
 
 /*
@@ -697,10 +1380,12 @@ gpusort_multi(cl_int mergesort_unitsz,
  * then gpusort_single modifies this index array later.
  */
 __kernel void
+__attribute__((work_group_size_hint(GPUSORT_LOCAL_WORKSZ,1,1)))
 gpusort_setup_chunk_rs(cl_uint rcs_gindex,
 					   __global kern_gpusort *kgpusort,
 					   __global kern_row_store *krs,
 					   cl_int	krs_nitems,
+					   cl_uint	kcs_base,
 					   __local void *local_workmem)
 {
 	__global kern_parambuf	   *kparams = KERN_GPUSORT_PARAMBUF(kgpusort);
@@ -709,11 +1394,13 @@ gpusort_setup_chunk_rs(cl_uint rcs_gindex,
 	__global cl_int			   *kstatus = KERN_GPUSORT_STATUS(kgpusort);
 	__global cl_char		   *attrefs;
 	__global cl_uint		   *rindex;
-	__local size_t	kcs_offset;
-	__local size_t	kcs_nitems;
+	cl_uint			wg_base;
+	cl_uint			kcs_offset;
+	cl_uint			kcs_nitems;
 	size_t			kcs_index;	/* destination */
 	size_t			krs_index;	/* source */
 	pg_bytea_t		kparam_0;
+	cl_ulong		my_key = 0;
 	cl_int			errcode = StromError_Success;
 
 	/* if number of valid items are negative, it means all the items
@@ -730,18 +1417,22 @@ gpusort_setup_chunk_rs(cl_uint rcs_gindex,
 									  STROMALIGN(krs->length));
 	}
 
-	/* determine number of items to be moved */
-	if (get_local_id(0) == 0)
-	{
-		if (get_global_id(0) + get_local_size(0) < krs_nitems)
-			kcs_nitems = get_local_size(0);
-		else if (get_global_id(0) < krs_nitems)
-			kcs_nitems = krs_nitems - get_global_id(0);
-		else
-			kcs_nitems = 0;
-		kcs_offset = atomic_add(&kcs->nrows, kcs_nitems);
-	}
-	barrier(CLK_LOCAL_MEM_FENCE);
+	/*
+	 * Determine number of items to be moved. The back-end knows how
+	 * many rows each source store supplies, so it tells us the base
+	 * offset of this kernel invocation via kcs_base and puts the total
+	 * number of rows on kcs->nrows in advance; the range this workgroup
+	 * fills up is a pure function of its position, without any global
+	 * counter to be touched.
+	 */
+	wg_base = get_global_id(0) - get_local_id(0);
+	if (wg_base + get_local_size(0) < krs_nitems)
+		kcs_nitems = get_local_size(0);
+	else if (wg_base < krs_nitems)
+		kcs_nitems = krs_nitems - wg_base;
+	else
+		kcs_nitems = 0;
+	kcs_offset = kcs_base + wg_base;
 	kcs_index = kcs_offset + get_local_id(0);
 
 	/*
@@ -770,25 +1461,34 @@ gpusort_setup_chunk_rs(cl_uint rcs_gindex,
 
 	if (get_local_id(0) < kcs_nitems)
 	{
-		cl_uint		ncols = kcs->ncols;
-		cl_ulong	growid = (cl_ulong)rcs_gindex << 32 | krs_index;
-		__global cl_char   *addr;
-
-		/* second last column is global row-id */
-		addr = kern_get_datum(kcs, ncols - 2, kcs_index);
-		*((__global cl_ulong *)addr) = growid;
-		/* last column is index number within a chunk */
-		addr = kern_get_datum(kcs, ncols - 1, kcs_index);
-		*((__global cl_uint *)addr) = kcs_index;
+		/*
+		 * All the reserved columns are fixed-width and never NULL,
+		 * so we can address their arrays directly instead of walking
+		 * through kern_get_datum(). Adjacent threads write adjacent
+		 * slots of each array, so the stores are coalesced per column.
+		 */
+		__global cl_ulong  *growid = gpusort_global_rowid(kcs);
+		__global cl_int	   *results = gpusort_result_index(kcs);
+		__global cl_ulong  *keys = gpusort_keys(kcs);
+
+		growid[kcs_index] = (cl_ulong)rcs_gindex << 32 | krs_index;
+		results[kcs_index] = kcs_index;
+		my_key = gpusort_keyenc(&errcode, kcs, ktoast, kcs_index);
+		keys[kcs_index] = my_key;
 	}
+	gpusort_keyrange_update(kgpusort, my_key,
+							get_local_id(0) < kcs_nitems,
+							local_workmem);
 	kern_writeback_error_status(kstatus, errcode, local_workmem);
 }
 
 __kernel void
+__attribute__((work_group_size_hint(GPUSORT_LOCAL_WORKSZ,1,1)))
 gpusort_setup_chunk_cs(cl_uint rcs_gindex,
 					   __global kern_gpusort *kgsort,
 					   __global kern_column_store *kcs_src,
 					   cl_int   src_nitems,
+					   cl_uint  kcs_base,
 					   __local void *local_workmem)
 {
 	__global kern_parambuf	   *kparams = KERN_GPUSORT_PARAMBUF(kgsort);
@@ -798,11 +1498,13 @@ gpusort_setup_chunk_cs(cl_uint rcs_gindex,
 	__global kern_toastbuf	   *ktoast_src =
 		(__global kern_toastbuf *)((__global char *)kcs_src + kcs_src->length);
 	__global cl_int			   *rindex;
-	__local size_t	dst_offset;
-	__local size_t	dst_nitems;
+	cl_uint			wg_base;
+	cl_uint			dst_offset;
+	cl_uint			dst_nitems;
 	size_t			dst_index;	/* index on the destination column-store */
 	size_t			src_index;	/* index on the source column-store */
 	cl_uint			ncols = kcs_src->ncols;
+	cl_ulong		my_key = 0;
 	cl_int			errcode = StromError_Success;
 
 	/*
@@ -819,18 +1521,19 @@ gpusort_setup_chunk_cs(cl_uint rcs_gindex,
 		rindex = KERN_GPUSORT_RESULT_INDEX(kcs_src);
 	}
 
-	/* determine number of items to be moved */
-	if (get_local_id(0) == 0)
-	{
-		if (get_global_id(0) + get_local_size(0) < src_nitems)
-			dst_nitems = get_local_size(0);
-		else if (get_global_id(0) < src_nitems)
-			dst_nitems = src_nitems - get_global_id(0);
-		else
-			dst_nitems = 0;
-		dst_offset = atomic_add(&kcs_dst->nrows, dst_nitems);
-	}
-	barrier(CLK_LOCAL_MEM_FENCE);
+	/*
+	 * Determine number of items to be moved; the base offset of this
+	 * invocation comes from the back-end via kcs_base, see the
+	 * description on gpusort_setup_chunk_rs.
+	 */
+	wg_base = get_global_id(0) - get_local_id(0);
+	if (wg_base + get_local_size(0) < src_nitems)
+		dst_nitems = get_local_size(0);
+	else if (wg_base < src_nitems)
+		dst_nitems = src_nitems - wg_base;
+	else
+		dst_nitems = 0;
+	dst_offset = kcs_base + wg_base;
 	dst_index = dst_offset + get_local_id(0);
 
 	/*
@@ -844,9 +1547,10 @@ gpusort_setup_chunk_cs(cl_uint rcs_gindex,
 	else
 		src_index = kcs_src->nrows;		/* performs as an invalid row */
 
-	/* move data from source to destination column-store */
+	/* move data from source to destination column-store; the three
+	 * reserved columns on the tail are not copied, but put below */
 	kern_column_to_column(&errcode,
-						  ncols - 2,
+						  ncols - 3,
 						  kcs_dst,
 						  ktoast_dst,
 						  dst_index,
@@ -855,20 +1559,22 @@ gpusort_setup_chunk_cs(cl_uint rcs_gindex,
 						  src_index,
 						  local_workmem);
 
-	/* also, growid and rindex shall be put */
+	/* also, growid, rindex and encoded keys shall be put */
 	if (get_local_id(0) < dst_nitems)
 	{
-		cl_uint		ncols = kcs_dst->ncols;
-		cl_ulong	growid = (cl_ulong)rcs_gindex << 32 | src_index;
-		__global cl_char   *addr;
-
-		/* second last column is global row-id */
-		addr = kern_get_datum(kcs_dst, ncols - 2, dst_index);
-		*((__global cl_ulong *)addr) = growid;
-		/* last column is index number within a chunk */
-		addr = kern_get_datum(kcs_dst, ncols - 1, dst_index);
-		*((__global cl_uint *)addr) = dst_index;
+		/* see the description on gpusort_setup_chunk_rs */
+		__global cl_ulong  *growid = gpusort_global_rowid(kcs_dst);
+		__global cl_int	   *results = gpusort_result_index(kcs_dst);
+		__global cl_ulong  *keys = gpusort_keys(kcs_dst);
+
+		growid[dst_index] = (cl_ulong)rcs_gindex << 32 | src_index;
+		results[dst_index] = dst_index;
+		my_key = gpusort_keyenc(&errcode, kcs_dst, ktoast_dst, dst_index);
+		keys[dst_index] = my_key;
 	}
+	gpusort_keyrange_update(kgsort, my_key,
+							get_local_id(0) < dst_nitems,
+							local_workmem);
 	kern_writeback_error_status(kstatus, errcode, local_workmem);
 }
 
@@ -895,6 +1601,11 @@ typedef struct
 	dlist_node		chain;		/* be linked to free list */
 	bool			has_rindex;	/* true. if some rows may not be valid */
 	bool			is_sorted;	/* true, if already sorted */
+	cl_int			radix_attlen;	/* attlen of the sort key, if radix
+									 * sorting is applicable. elsewhere 0 */
+	bool			radix_reverse;	/* true, if descending ordered */
+	bool			sort_persistent;/* true, if in-chunk sorting takes the
+									 * single persistent kernel */
 	dlist_head		gs_chunks;	/* chunked being sorted, or to be sorted */
 } pgstrom_gpusort;
 
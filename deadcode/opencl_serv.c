@@ -172,7 +172,13 @@ init_opencl_context_and_shmem(void)
 		elog(ERROR, "clCreateContext failed: %s", opencl_strerror(rc));
 
 	/*
-	 * Create an OpenCL command queue for each device
+	 * Create OpenCL command queues for each device; one for kernel
+	 * execution and one for DMA transfer. Even though both of them
+	 * are out-of-order capable, several OpenCL runtimes map distinct
+	 * command queues on distinct hardware queues, so a separated
+	 * queue allows the copy engine to move a buffer of the next
+	 * request while the compute engine is still in the current one.
+	 * Ordering between them is enforced by event dependencies.
 	 */
 	for (i=0; i < opencl_num_devices; i++)
 	{
@@ -188,6 +194,16 @@ init_opencl_context_and_shmem(void)
 			elog(ERROR, "clCreateCommandQueue failed: %s",
 				 opencl_strerror(rc));
 
+		opencl_dmaq[i] =
+			clCreateCommandQueue(opencl_context,
+								 opencl_devices[i],
+								 CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE |
+								 CL_QUEUE_PROFILING_ENABLE,
+								 &rc);
+		if (rc != CL_SUCCESS)
+			elog(ERROR, "clCreateCommandQueue failed: %s",
+				 opencl_strerror(rc));
+
 		if (zone_length > dev_info->dev_max_mem_alloc_size)
 			zone_length = (dev_info->dev_max_mem_alloc_size &
 						   ~((1UL << 20) - 1));